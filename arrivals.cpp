@@ -0,0 +1,297 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "arrivals.h"
+#include <QtGlobal>
+#include <QStringList>
+#include <QRegExp>
+#include <QDebug>
+
+
+bool RegularArrivals::next (double rate, Rng &, Arrival &a) {
+
+    a.t += 1.0 / rate;
+    a.placed = false;
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The pending gap was drawn at the old rate; if it's longer than a whole gap
+ * at the new one, cut it short (so a rate increase has no lag).
+ */
+//-----------------------------------------------------------------------------
+
+void RegularArrivals::rateChanged (double rate, double now, Rng &, Arrival &a) {
+
+    if (a.t - now > 1.0 / rate)
+        a.t = now + 1.0 / rate;
+
+}
+
+
+bool PoissonArrivals::next (double rate, Rng &rng, Arrival &a) {
+
+    a.t += rng.exponential(1.0 / rate);
+    a.placed = false;
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Gaps are memoryless, so the remaining gap can simply be redrawn from now
+ * at the new rate without biasing the process.
+ */
+//-----------------------------------------------------------------------------
+
+void PoissonArrivals::rateChanged (double rate, double now, Rng &rng, Arrival &a) {
+
+    a.t = now;
+    next(rate, rng, a);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor.
+ *
+ * @param   meanOn  Mean length of on (arriving) periods, in seconds.
+ * @param   meanOff Mean length of off (gap) periods, in seconds.
+ */
+//-----------------------------------------------------------------------------
+
+BurstyArrivals::BurstyArrivals (double meanOn, double meanOff) :
+    meanOn_(meanOn),
+    meanOff_(meanOff),
+    started_(false)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Draw an arrival time from time from, which is in or before periods_[0].
+ * Since both the gaps and the periods are exponential we can just draw a gap
+ * and, if it runs past the end of the on period, skip over an off period and
+ * draw again from the start of the next on period (drawing new periods as
+ * needed). Afterwards periods_ ends with the period holding the arrival.
+ */
+//-----------------------------------------------------------------------------
+
+double BurstyArrivals::draw (double from, double rate, Rng &rng) {
+
+    double onrate = rate * (meanOn_ + meanOff_) / meanOn_;
+    int k = 0;
+
+    double t = qMax(from, periods_[0].start) + rng.exponential(1.0 / onrate);
+    while (t > periods_[k].end) {
+        if (++ k == periods_.size()) {
+            Period p;
+            p.start = periods_.back().end + rng.exponential(meanOff_);
+            p.end = p.start + rng.exponential(meanOn_);
+            periods_.append(p);
+        }
+        t = periods_[k].start + rng.exponential(1.0 / onrate);
+    }
+
+    periods_.resize(k + 1);
+    return t;
+
+}
+
+
+bool BurstyArrivals::next (double rate, Rng &rng, Arrival &a) {
+
+    if (!started_) {
+        Period p;
+        p.start = a.t;
+        p.end = a.t + rng.exponential(meanOn_);
+        periods_.append(p);
+        started_ = true;
+    }
+
+    // a.t is in the last period; the ones before it are over
+    periods_.remove(0, periods_.size() - 1);
+
+    a.t = draw(a.t, rate, rng);
+    a.placed = false;
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Gaps within on periods are memoryless, so redraw the pending arrival at
+ * the new rate from now, using the on periods already drawn between now and
+ * it (they don't depend on the rate, and keeping them keeps the on time in
+ * between). Periods that are already over are dropped first.
+ */
+//-----------------------------------------------------------------------------
+
+void BurstyArrivals::rateChanged (double rate, double now, Rng &rng, Arrival &a) {
+
+    if (!started_)
+        return;
+
+    int over = 0;
+    while (over < periods_.size() - 1 && periods_[over].end <= now)
+        ++ over;
+    periods_.remove(0, over);
+
+    a.t = draw(now, rate, rng);
+
+}
+
+
+void BurstyArrivals::reset () {
+
+    started_ = false;
+    periods_.clear();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Opens the file; check isOpen() afterwards.
+ *
+ * @param   filename    Trace file name.
+ */
+//-----------------------------------------------------------------------------
+
+TraceArrivals::TraceArrivals (const QString &filename) :
+    file_(filename),
+    started_(false),
+    base_(0),
+    last_(0),
+    line_(0)
+{
+
+    if (file_.open(QIODevice::ReadOnly | QIODevice::Text))
+        in_.setDevice(&file_);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Opens the same file again and continues from the same place.
+ */
+//-----------------------------------------------------------------------------
+
+ArrivalModel * TraceArrivals::clone () const {
+
+    TraceArrivals *copy = new TraceArrivals(file_.fileName());
+
+    if (copy->isOpen())
+        copy->in_.seek(in_.pos());
+    copy->started_ = started_;
+    copy->base_ = base_;
+    copy->last_ = last_;
+    copy->line_ = line_;
+
+    return copy;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Rewinds to the start of the file. The replay restarts relative to the
+ * simulation time of the next arrival requested.
+ */
+//-----------------------------------------------------------------------------
+
+void TraceArrivals::reset () {
+
+    if (isOpen())
+        in_.seek(0);
+    started_ = false;
+    base_ = 0;
+    last_ = 0;
+    line_ = 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Reads the next usable line. Malformed lines are skipped with a warning.
+ * Timestamps that go backwards are clamped to the previous one.
+ */
+//-----------------------------------------------------------------------------
+
+bool TraceArrivals::next (double, Rng &, Arrival &a) {
+
+    if (!file_.isOpen())
+        return false;
+
+    if (!started_) {
+        base_ = a.t;
+        started_ = true;
+    }
+
+    while (!in_.atEnd()) {
+
+        QString line = in_.readLine().trimmed();
+        ++ line_;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QStringList fields = line.split(QRegExp("[\\s,]+"), QString::SkipEmptyParts);
+        if (fields.isEmpty())
+            continue;
+        bool ok = true, okx = true, oky = true;
+        double t = fields[0].toDouble(&ok);
+        if (!ok || (fields.size() != 1 && fields.size() != 3)) {
+            qWarning() << "arrival trace line" << line_ << "malformed, skipped";
+            continue;
+        }
+
+        a.placed = false;
+        if (fields.size() == 3) {
+            a.pos = QPointF(fields[1].toDouble(&okx), fields[2].toDouble(&oky));
+            a.placed = okx && oky;
+        }
+
+        last_ = qMax(last_, t);
+        a.t = base_ + last_;
+        return true;
+
+    }
+
+    return false;
+
+}
@@ -0,0 +1,191 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef ARRIVALS_H
+#define ARRIVALS_H
+
+#include <QPointF>
+#include <QString>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+#include "rng.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Cone arrival process. Simulator::updateCones() asks one of these when the
+ * next cone should be dropped on the belt (and, optionally, where). The
+ * default is RegularArrivals, which is the original fixed 1/coneRate spacing.
+ */
+//-----------------------------------------------------------------------------
+
+class ArrivalModel {
+public:
+
+    /** One arrival. */
+    struct Arrival {
+        double t;       /**< Timestamp (simulation seconds). */
+        bool placed;    /**< If true, pos is used instead of a random drop point. */
+        QPointF pos;    /**< Drop position (only if placed). */
+        Arrival () : t(0), placed(false) { }
+    };
+
+    virtual ~ArrivalModel () { }
+
+    /**
+     * Compute the arrival following a. On entry a holds the previous arrival
+     * (or the current simulation time if there wasn't one); on return it holds
+     * the next one.
+     *
+     * @param   rate    Current Parameters::coneRate (cones / second).
+     * @param   rng     The simulator's random number generator.
+     * @param   a       Previous arrival in, next arrival out.
+     * @return  False if there are no more arrivals.
+     */
+    virtual bool next (double rate, Rng &rng, Arrival &a) = 0;
+
+    /**
+     * Reschedule the pending arrival a after Parameters::coneRate changed at
+     * time now, so the new rate takes effect right away rather than after
+     * the gap drawn at the old one. The default does nothing, for models
+     * whose arrival times don't depend on the rate.
+     *
+     * @param   rate    New Parameters::coneRate (cones / second).
+     * @param   now     Current simulation time.
+     * @param   rng     The simulator's random number generator.
+     * @param   a       Pending arrival (after now), updated in place.
+     */
+    virtual void rateChanged (double rate, double now, Rng &rng, Arrival &a) {
+        Q_UNUSED(rate); Q_UNUSED(now); Q_UNUSED(rng); Q_UNUSED(a);
+    }
+
+    /** Go back to the state before the first arrival, for
+     *  Simulator::reset(). The default does nothing, for stateless models. */
+    virtual void reset () { }
+
+    /** @return A copy in the same state, for Simulator::clone(). */
+    virtual ArrivalModel * clone () const = 0;
+
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Exactly one cone every 1/rate seconds.
+ */
+//-----------------------------------------------------------------------------
+
+class RegularArrivals : public ArrivalModel {
+public:
+    bool next (double rate, Rng &rng, Arrival &a);
+    void rateChanged (double rate, double now, Rng &rng, Arrival &a);
+    ArrivalModel * clone () const { return new RegularArrivals(*this); }
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Poisson process; exponentially distributed gaps with mean 1/rate.
+ */
+//-----------------------------------------------------------------------------
+
+class PoissonArrivals : public ArrivalModel {
+public:
+    bool next (double rate, Rng &rng, Arrival &a);
+    void rateChanged (double rate, double now, Rng &rng, Arrival &a);
+    ArrivalModel * clone () const { return new PoissonArrivals(*this); }
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * On/off bursts. On and off periods have exponentially distributed lengths;
+ * cones only arrive (Poisson) during on periods, at a boosted rate so that the
+ * long term average is still the requested rate.
+ */
+//-----------------------------------------------------------------------------
+
+class BurstyArrivals : public ArrivalModel {
+public:
+    BurstyArrivals (double meanOn, double meanOff);
+    bool next (double rate, Rng &rng, Arrival &a);
+    void rateChanged (double rate, double now, Rng &rng, Arrival &a);
+    void reset ();
+    ArrivalModel * clone () const { return new BurstyArrivals(*this); }
+private:
+    /** One on period. */
+    struct Period {
+        double start;
+        double end;
+    };
+    double meanOn_;     /**< Mean on period length (seconds). */
+    double meanOff_;    /**< Mean off period length (seconds). */
+    bool started_;      /**< Has the first on period been set up yet? */
+    QVector<Period> periods_; /**< On periods up to the one holding the pending
+                                   arrival, oldest first. */
+    double draw (double from, double rate, Rng &rng);
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Replays arrivals from a text file, one per line:
+ *
+ *     time [x y]
+ *
+ * Times are seconds relative to the start of the replay and must not
+ * decrease. If x and y are given the cone is dropped there, otherwise at a
+ * random point in the drop area. Blank lines and lines starting with # are
+ * ignored. The file is read one line at a time as the simulation needs it, so
+ * traces can be arbitrarily long.
+ */
+//-----------------------------------------------------------------------------
+
+class TraceArrivals : public ArrivalModel {
+public:
+    explicit TraceArrivals (const QString &filename);
+    bool next (double rate, Rng &rng, Arrival &a);
+    void reset ();
+    ArrivalModel * clone () const;
+    /** @return True if the file was opened successfully. */
+    bool isOpen () const { return file_.isOpen(); }
+    /** @return Description of the last error, if any. */
+    QString errorString () const { return file_.errorString(); }
+private:
+    QFile file_;        /**< Trace file. */
+    QTextStream in_;    /**< Reader for file_. */
+    bool started_;      /**< Has base_ been set yet? */
+    double base_;       /**< Simulation time the replay started at. */
+    double last_;       /**< Last timestamp read (relative to base_). */
+    int line_;          /**< Current line number, for warnings. */
+};
+
+
+#endif // ARRIVALS_H
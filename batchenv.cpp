@@ -0,0 +1,235 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#include "batchenv.h"
+#include <QtCore/QtConcurrentMap>
+
+#define ENV_SLICE_SIZE      16      /**< Envs per pool task. */
+#define EPISODE_SECONDS     300.0   /**< Default episode length. */
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. The envs are ready to step after this (no need to reset()).
+ *
+ * @param   p       Simulation parameters for every env.
+ * @param   envs    Number of envs.
+ * @param   coneSlots   Number of cones observed per env.
+ * @param   seed    Base seed, see the class description.
+ */
+//-----------------------------------------------------------------------------
+
+BatchEnv::BatchEnv (const Simulator::Parameters &p, int envs, int coneSlots, quint64 seed) :
+    p_(p),
+    coneSlots_(qMax(1, coneSlots)),
+    repeat_(1),
+    seed_(seed),
+    sims_(envs, NULL),
+    elapsed_(envs, 0),
+    episodes_(envs, 0),
+    ids_(envs * coneSlots_, 0),
+    actions_(envs, -1),
+    hoseX_(envs, 0.0f),
+    hoseY_(envs, 0.0f),
+    hoseBusy_(envs, 0.0f),
+    coneX_(envs * coneSlots_, 0.0f),
+    coneY_(envs * coneSlots_, 0.0f),
+    coneFill_(envs * coneSlots_, 0.0f),
+    coneMask_(envs * coneSlots_, 0.0f),
+    rewards_(envs, 0.0f),
+    dones_(envs, 0)
+{
+
+    setEpisodeSeconds(EPISODE_SECONDS);
+
+    for (int n = 0; n < envs; n += ENV_SLICE_SIZE) {
+        Slice s;
+        s.env = this;
+        s.begin = n;
+        s.end = qMin(n + ENV_SLICE_SIZE, envs);
+        slices_.append(s);
+    }
+
+    for (int i = 0; i < envs; ++ i) {
+        sims_[i] = new Simulator(p_);
+        sims_[i]->setExternalControl(true);
+        sims_[i]->setParallelThreshold(0);
+    }
+
+    reset();
+
+}
+
+
+BatchEnv::~BatchEnv () {
+
+    qDeleteAll(sims_);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Start a new episode in every env.
+ */
+//-----------------------------------------------------------------------------
+
+void BatchEnv::reset () {
+
+    for (int i = 0; i < sims_.size(); ++ i) {
+        resetEnv(i);
+        rewards_[i] = 0.0f;
+        dones_[i] = 0;
+        observe(i);
+    }
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Apply actions() and advance every env by the action repeat.
+ */
+//-----------------------------------------------------------------------------
+
+void BatchEnv::step () {
+
+    if (slices_.size() > 1)
+        QtConcurrent::blockingMap(slices_, &BatchEnv::stepSlice);
+    else if (!slices_.isEmpty())
+        stepSlice(slices_[0]);
+
+}
+
+
+void BatchEnv::stepSlice (Slice &s) {
+
+    for (int i = s.begin; i < s.end; ++ i)
+        s.env->stepEnv(i);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Restart env i's simulation in place (Simulator::reset()), for its next
+ * episode. Only touches env i's entries.
+ */
+//-----------------------------------------------------------------------------
+
+void BatchEnv::resetEnv (int i) {
+
+    sims_[i]->reset(seed_ + (episodes_[i] ++) * sims_.size() + i);
+    elapsed_[i] = 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * One step of env i. Only touches env i's entries, so envs can be stepped
+ * concurrently. Episodes that end are restarted here.
+ */
+//-----------------------------------------------------------------------------
+
+void BatchEnv::stepEnv (int i) {
+
+    Simulator *sim = sims_[i];
+    Simulator::HoseCommand c;
+    qint32 action = actions_[i];
+
+    if (action >= 0 && action < coneSlots_ && coneMask_[i * coneSlots_ + action] > 0.0f) {
+        c.hasTarget = true;
+        c.targetId = ids_[i * coneSlots_ + action];
+    } else {
+        c.dest = QVector2D(p_.hoseRange.left(), p_.hoseRange.center().y());
+    }
+    sim->command(c);
+
+    Simulator::Stats before = sim->stats();
+    for (int n = 0; n < repeat_; ++ n)
+        sim->update();
+    elapsed_[i] += repeat_;
+
+    const Simulator::Stats &after = sim->stats();
+    rewards_[i] = (float)(after.completed - before.completed) - (float)(after.escaped - before.escaped);
+    dones_[i] = (elapsed_[i] >= episodeSteps_);
+
+    if (dones_[i])
+        resetEnv(i);
+
+    observe(i);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Write env i's observations: the hose, then the unfilled cones in the hose
+ * range, the ones closest to leaving first. Walks Simulator::conesByX()
+ * back from the right edge of the range, so it doesn't allocate.
+ */
+//-----------------------------------------------------------------------------
+
+void BatchEnv::observe (int i) {
+
+    const Simulator *sim = sims_[i];
+    const Simulator::Parameters &p = sim->params();
+    const Simulator::Hose &h = sim->hose();
+    int base = i * coneSlots_, k = 0;
+
+    hoseX_[i] = (float)h.pos.x();
+    hoseY_[i] = (float)h.pos.y();
+    hoseBusy_[i] = (h.state == Simulator::Hose::Idle ? 0.0f : 1.0f);
+
+    const QList<Simulator::Cone *> &cones = sim->conesByX();
+    for (int n = sim->conesUpTo(p.hoseRange.right()) - 1; n >= 0 && k < coneSlots_; -- n) {
+        const Simulator::Cone *cone = cones[n];
+        if (cone->pos.x() < p.hoseRange.left())
+            break;
+        if (cone->fill >= 1.0 || !p.hoseRange.contains(cone->pos))
+            continue;
+        coneX_[base + k] = (float)cone->pos.x();
+        coneY_[base + k] = (float)cone->pos.y();
+        coneFill_[base + k] = (float)cone->fill;
+        coneMask_[base + k] = 1.0f;
+        ids_[base + k] = cone->id;
+        ++ k;
+    }
+
+    for (; k < coneSlots_; ++ k) {
+        coneX_[base + k] = 0.0f;
+        coneY_[base + k] = 0.0f;
+        coneFill_[base + k] = 0.0f;
+        coneMask_[base + k] = 0.0f;
+        ids_[base + k] = 0;
+    }
+
+}
@@ -0,0 +1,148 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#ifndef BATCHENV_H
+#define BATCHENV_H
+
+#include <QVector>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Many independent simulations stepped in lockstep, for training hose
+ * policies. Every simulation runs under external control (see
+ * Simulator::setExternalControl()) and the policy picks which cone to fill.
+ *
+ * All inputs and outputs are flat arrays owned by the BatchEnv, one field
+ * per array (structure of arrays), so a training loop can wrap them without
+ * copying. Per-env fields have envs() entries; per-cone fields have
+ * envs() * coneSlots() entries, env i's cones at
+ * [i * coneSlots(), (i + 1) * coneSlots()). The arrays stay at the same
+ * address for the BatchEnv's lifetime and are overwritten by every step()
+ * and reset().
+ *
+ * Each step:
+ *
+ * 1. Fill actions(): a cone slot in [0, coneSlots()) to fill that cone, or -1
+ *    (or an empty slot) to go idle. A fill in progress always finishes.
+ * 2. Call step().
+ * 3. Read the new observations, rewards() and dones().
+ *
+ * Observed cones are the unfilled ones in the hose range, the ones closest
+ * to leaving it first. Rewards are +1 for every fill completed during the
+ * step and -1 for every cone that left the hose range unfilled during it
+ * (Stats::completed and Stats::escaped), so an action is credited as soon
+ * as its outcome is known, not when the cone reaches the end of the belt
+ * (which may be after the episode). An env whose episode ended has dones()
+ * set and has already been reset (with a new seed), so its observations are
+ * the start of the next episode. Env i's nth episode is seeded with
+ * seed + n * envs() + i.
+ *
+ * Envs are spread across the global QThreadPool in fixed slices, so results
+ * don't depend on the number of threads.
+ */
+//-----------------------------------------------------------------------------
+
+class BatchEnv {
+public:
+
+    BatchEnv (const Simulator::Parameters &p, int envs, int coneSlots, quint64 seed = 1);
+    ~BatchEnv ();
+
+    /** @return Number of envs. */
+    int envs () const { return sims_.size(); }
+
+    /** @return Cone slots per env. */
+    int coneSlots () const { return coneSlots_; }
+
+    /** Set episode length (simulated seconds). Default 300. */
+    void setEpisodeSeconds (double seconds) { episodeSteps_ = qMax(1, (int)(seconds / p_.timestep + 0.5)); }
+
+    /** Set Simulator steps per step(). Default 1. */
+    void setActionRepeat (int steps) { repeat_ = qMax(1, steps); }
+
+    void reset ();
+    void step ();
+
+    /** @return Action per env, filled in by the caller before step(). */
+    qint32 * actions () { return actions_.data(); }
+
+    const float * hoseX () const { return hoseX_.constData(); }     /**< Hose X, per env. */
+    const float * hoseY () const { return hoseY_.constData(); }     /**< Hose Y, per env. */
+    const float * hoseBusy () const { return hoseBusy_.constData(); } /**< 1 if approaching or filling a cone, per env. */
+    const float * coneX () const { return coneX_.constData(); }     /**< Cone X, per slot. */
+    const float * coneY () const { return coneY_.constData(); }     /**< Cone Y, per slot. */
+    const float * coneFill () const { return coneFill_.constData(); } /**< Cone fill (0 to 1), per slot. */
+    const float * coneMask () const { return coneMask_.constData(); } /**< 1 if the slot holds a cone, per slot. */
+    const float * rewards () const { return rewards_.constData(); } /**< Reward of the last step, per env. */
+    const quint8 * dones () const { return dones_.constData(); }    /**< 1 if the episode ended, per env. */
+
+private:
+
+    /** A range of envs stepped by one pool task. */
+    struct Slice {
+        BatchEnv *env;  /**< Owner. */
+        int begin;      /**< First env. */
+        int end;        /**< One past the last env. */
+    };
+
+    Simulator::Parameters p_;       /**< Parameters for every env. */
+    int coneSlots_;                 /**< Cone slots per env. */
+    int episodeSteps_;              /**< Simulator steps per episode. */
+    int repeat_;                    /**< Simulator steps per step(). */
+    quint64 seed_;                  /**< Base seed. */
+    QVector<Simulator *> sims_;     /**< The envs (owned). */
+    QVector<int> elapsed_;          /**< Simulator steps into the episode, per env. */
+    QVector<quint64> episodes_;     /**< Episodes started, per env. */
+    QVector<quint32> ids_;          /**< Cone::id per slot, for actions. */
+    QVector<Slice> slices_;         /**< Work split for step(). */
+    QVector<qint32> actions_;
+    QVector<float> hoseX_;
+    QVector<float> hoseY_;
+    QVector<float> hoseBusy_;
+    QVector<float> coneX_;
+    QVector<float> coneY_;
+    QVector<float> coneFill_;
+    QVector<float> coneMask_;
+    QVector<float> rewards_;
+    QVector<quint8> dones_;
+
+    void resetEnv (int i);
+    void stepEnv (int i);
+    void observe (int i);
+    static void stepSlice (Slice &s);
+
+    Q_DISABLE_COPY(BatchEnv)
+
+};
+
+
+#endif // BATCHENV_H
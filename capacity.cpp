@@ -0,0 +1,385 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#include "capacity.h"
+#include "scenarios.h"
+#include <cmath>
+#include <QVector>
+#include <QVector2D>
+#include <qmath.h>
+#include <QtCore/QtConcurrentMap>
+
+#define QUADRATURE_POINTS   24      /**< Points per axis for the travel integral. */
+#define RATE_ITERATIONS     40      /**< Bisection steps for the model's max rate. */
+#define SIM_ITERATIONS      7       /**< Bisection steps for the simulator's max rate. */
+#define SIM_DOUBLINGS       4       /**< Most times the simulator search ceiling is doubled. */
+#define VALIDATE_POINTS     81      /**< validate() grid points (3 values on each of 4 axes). */
+#define MIN_TRANSITS        2.0     /**< Shortest simulator run, in belt transit times. */
+#define SUSTAINED_FILL      0.99    /**< Fill ratio that counts as keeping up. */
+#define SUSTAINED_BLOCKED   0.01    /**< Fraction of dropped arrivals that still counts. */
+#define PACKING_DENSITY     0.55    /**< Random sequential packing density of cone footprints. */
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Midpoint rule nodes and weights for the difference of two independent
+ * uniform offsets on [0, width], whose density is triangular on
+ * [-width, width]. Weights add up to 1.
+ */
+//-----------------------------------------------------------------------------
+
+static void triangular (double width, QVector<double> &nodes, QVector<double> &weights) {
+
+    nodes.clear();
+    weights.clear();
+
+    if (width <= 0.0) {
+        nodes << 0.0;
+        weights << 1.0;
+        return;
+    }
+
+    double step = 2.0 * width / QUADRATURE_POINTS, total = 0.0;
+    for (int n = 0; n < QUADRATURE_POINTS; ++ n) {
+        double z = -width + (n + 0.5) * step;
+        nodes << z;
+        weights << (width - qAbs(z));
+        total += weights.back();
+    }
+    for (int n = 0; n < weights.size(); ++ n)
+        weights[n] /= total;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Expected intercept time from the hose to a cone at one of the given
+ * offsets from it, moving with the belt.
+ *
+ * @return  Expected time, or HUGE_VAL if some offset can't be caught.
+ */
+//-----------------------------------------------------------------------------
+
+static double expectedTravel (const Simulator::Parameters &p,
+                              const QVector<QVector2D> &offsets,
+                              const QVector<double> &weights)
+{
+
+    ConstantSpeedDrive drive(p.hoseSpeed);
+    QVector2D origin(p.hoseRange.center());
+    QVector2D coneVel(p.beltSpeed, 0);
+    double expected = 0.0;
+
+    drive.moveTo(origin, coneVel, true);
+
+    for (int n = 0; n < offsets.size(); ++ n) {
+        double t;
+        if (drive.calcIntercept(origin + offsets[n], coneVel, &t).isNull())
+            return HUGE_VAL;
+        expected += weights[n] * t;
+    }
+
+    return expected;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Hose time per cone at saturation: expected travel from the cone just
+ * filled to the next one, plus the fill (rounded up to whole timesteps like
+ * the simulator does it), plus one timestep for the step spent going idle
+ * between fills.
+ *
+ * @param   p       Parameters.
+ * @param   rate    Cone rate (cones / second).
+ * @param   travel  If not NULL, receives the expected travel time.
+ * @return  Cycle time (seconds), or HUGE_VAL if the next cone can't be
+ *          caught.
+ */
+//-----------------------------------------------------------------------------
+
+double CapacityModel::cycleTime (const Simulator::Parameters &p, double rate, double *travel) {
+
+    QVector<double> xs, xw, ys, yw;
+    QVector<QVector2D> offsets;
+    QVector<double> weights;
+
+    // next in spawn order
+    triangular(p.coneDrop.width(), xs, xw);
+    triangular(p.coneDrop.height(), ys, yw);
+    for (int i = 0; i < xs.size(); ++ i) {
+        for (int j = 0; j < ys.size(); ++ j) {
+            offsets << QVector2D(xs[i] - p.beltSpeed / rate, ys[j]);
+            weights << xw[i] * yw[j];
+        }
+    }
+    double spawnOrder = expectedTravel(p, offsets, weights);
+
+    // nearest upstream neighbour: P(distance > r) = exp(-density * pi r^2 / 2)
+    // and the direction is uniform over the upstream half, sampled at
+    // midpoint quantiles
+    double density = rate / (p.beltSpeed * p.coneDrop.height());
+    offsets.clear();
+    weights.clear();
+    for (int i = 0; i < QUADRATURE_POINTS; ++ i) {
+        double r = std::sqrt(-2.0 * std::log(1.0 - (i + 0.5) / QUADRATURE_POINTS) / (density * M_PI));
+        for (int j = 0; j < QUADRATURE_POINTS; ++ j) {
+            double a = M_PI * (0.5 + (j + 0.5) / QUADRATURE_POINTS);
+            offsets << QVector2D(r * std::cos(a), r * std::sin(a));
+            weights << 1.0 / (QUADRATURE_POINTS * QUADRATURE_POINTS);
+        }
+    }
+    double nearest = expectedTravel(p, offsets, weights);
+
+    double expected = qMin(spawnOrder, nearest);
+    if (expected == HUGE_VAL)
+        return HUGE_VAL;
+
+    if (travel)
+        *travel = expected;
+
+    double fill = std::ceil(1.0 / (p.hoseFillRate * p.timestep) - 1e-9) * p.timestep;
+    return expected + fill + p.timestep;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Estimate the max sustainable cone rate. Bisects for the rate where the
+ * hose is busy all the time (rate * cycleTime(rate) = 1), then applies the
+ * hose range window and drop area limits. Takes about a millisecond.
+ */
+//-----------------------------------------------------------------------------
+
+CapacityModel::Estimate CapacityModel::estimate (const Simulator::Parameters &p) {
+
+    Estimate e;
+    e.fillTime = std::ceil(1.0 / (p.hoseFillRate * p.timestep) - 1e-9) * p.timestep;
+    e.window = p.hoseRange.width() / p.beltSpeed;
+    e.dropRate = PACKING_DENSITY * (p.coneDrop.height() / CONE_HEIGHT) * p.beltSpeed / CONE_WIDTH;
+
+    // hose always busy: rate * cycle(rate) grows with rate, find where it's 1
+    double lo = 0.0, hi = 1.0 / (e.fillTime + p.timestep);
+    if (hi * cycleTime(p, hi) <= 1.0) {
+        lo = hi;
+    } else {
+        for (int n = 0; n < RATE_ITERATIONS; ++ n) {
+            double mid = 0.5 * (lo + hi);
+            if (mid * cycleTime(p, mid) <= 1.0)
+                lo = mid;
+            else
+                hi = mid;
+        }
+    }
+
+    e.maxRate = qMin(lo, e.dropRate);
+    e.cycleTime = (e.maxRate > 0.0 ? cycleTime(p, e.maxRate, &e.travelTime) : 0.0);
+
+    // a cone has to be caught and filled before it leaves the range
+    if (e.maxRate <= 0.0 || e.cycleTime > e.window)
+        e.maxRate = 0.0;
+
+    return e;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * One headless run of s at the given rate.
+ *
+ * @return  True if the rate was sustained: the fill ratio is at least 99%
+ *          and under 1% of arrivals found no room in the drop area.
+ */
+//-----------------------------------------------------------------------------
+
+static bool sustained (Scenario &s, double rate) {
+
+    s.params.coneRate = rate;
+    Scenario::Result r = s.run();
+    quint64 arrivals = r.stats.spawned + r.stats.blocked;
+
+    return r.stats.fillRatio() >= SUSTAINED_FILL &&
+           r.stats.blocked <= SUSTAINED_BLOCKED * arrivals;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Measure the max sustainable rate with headless runs (see sustained()).
+ * The search ceiling starts at start and is doubled until a run fails, so
+ * the answer is known to be inside the bracket, which is then bisected
+ * SIM_ITERATIONS times. Starting from the model's prediction, that leaves a
+ * bracket of about 1% of the answer. Every run uses the same seed, so the
+ * result is also one sample of a noisy threshold; the bracket is the search
+ * resolution, not a confidence interval.
+ *
+ * That is at most SIM_DOUBLINGS + SIM_ITERATIONS runs. If the ceiling is
+ * still sustained after SIM_DOUBLINGS doublings (start was more than 16
+ * times too low) the search gives up there: the result is only a lower
+ * bound and the bracket is HUGE_VAL.
+ *
+ * @param   p       Parameters (coneRate is ignored).
+ * @param   start   First search ceiling, greater than 0.
+ * @param   seconds Simulated length of each run. Raised to MIN_TRANSITS
+ *                  times the time a cone takes to cross the belt if
+ *                  shorter, since the fill ratio only counts cones that got
+ *                  to the end.
+ * @param   bracket If not NULL, receives the final bracket width.
+ * @return  Highest rate found to be sustained (the bottom of the bracket).
+ */
+//-----------------------------------------------------------------------------
+
+double CapacityModel::simulatedMaxRate (const Simulator::Parameters &p, double start, double seconds, double *bracket) {
+
+    // fill ratio only counts cones that reached the end of the belt
+    double diepos = p.hoseRange.right() + (p.hoseRange.left() - p.coneDrop.right()) + 2.0;
+    double transit = (diepos - p.coneDrop.left()) / p.beltSpeed;
+
+    Scenario s;
+    s.params = p;
+    s.seconds = qMax(seconds, MIN_TRANSITS * transit);
+    s.parallelThreshold = 0;
+
+    double lo = 0.0, hi = start;
+    bool capped = true;
+    for (int n = 0; n < SIM_DOUBLINGS; ++ n) {
+        if (!sustained(s, hi)) {
+            capped = false;
+            break;
+        }
+        lo = hi;
+        hi *= 2.0;
+    }
+
+    if (capped) {
+        if (bracket)
+            *bracket = HUGE_VAL;
+        return lo;
+    }
+
+    for (int n = 0; n < SIM_ITERATIONS; ++ n) {
+        double mid = 0.5 * (lo + hi);
+        if (sustained(s, mid))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    if (bracket)
+        *bracket = hi - lo;
+
+    return lo;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Fills in Check::simulated and Check::bracket, for QtConcurrent::mapped().
+ */
+//-----------------------------------------------------------------------------
+
+struct Measure {
+    typedef CapacityModel::Check result_type;
+    double seconds;
+    explicit Measure (double seconds) : seconds(seconds) { }
+    CapacityModel::Check operator() (CapacityModel::Check c) const {
+        c.simulated = CapacityModel::simulatedMaxRate(c.params, qMax(c.predicted, 0.5), seconds, &c.bracket);
+        return c;
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Compare the model with the simulator over a grid of belt speed, hose speed,
+ * fill rate and hose range width around the GUI defaults (3 values each,
+ * VALIDATE_POINTS points). Grid points run in parallel on the global
+ * QThreadPool.
+ *
+ * Each point costs at most SIM_DOUBLINGS + SIM_ITERATIONS = 11 runs, and 8
+ * or 9 when the prediction is within a factor of two, so validateRuns() *
+ * seconds simulated seconds at worst; use a short seconds for a quick look.
+ * Runs are never shorter than simulatedMaxRate() allows (up to 292 s on this
+ * grid, for the slowest belt and widest range).
+ *
+ * @param   seconds     Simulated length of each run.
+ * @return  One Check per grid point.
+ */
+//-----------------------------------------------------------------------------
+
+QList<CapacityModel::Check> CapacityModel::validate (double seconds) {
+
+    static const double beltSpeeds[] = { 1.0, 2.0, 4.0 };
+    static const double hoseSpeeds[] = { 8.0, 20.0, 40.0 };
+    static const double fillRates[] = { 2.0, 3.0, 6.0 };
+    static const double hoseRanges[] = { 12.0, 36.0, 72.0 };
+
+    QList<Check> checks;
+    for (int b = 0; b < 3; ++ b) {
+        for (int h = 0; h < 3; ++ h) {
+            for (int f = 0; f < 3; ++ f) {
+                for (int r = 0; r < 3; ++ r) {
+                    Check c;
+                    c.params = Scenario().params;
+                    c.params.beltSpeed = beltSpeeds[b];
+                    c.params.hoseSpeed = hoseSpeeds[h];
+                    c.params.hoseFillRate = fillRates[f];
+                    c.params.hoseRange.setWidth(hoseRanges[r]);
+                    c.predicted = estimate(c.params).maxRate;
+                    c.simulated = 0.0;
+                    c.bracket = 0.0;
+                    checks << c;
+                }
+            }
+        }
+    }
+
+    return QtConcurrent::blockingMapped(checks, Measure(seconds));
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  Most headless runs validate() can make, over all grid points.
+ */
+//-----------------------------------------------------------------------------
+
+int CapacityModel::validateRuns () {
+
+    return VALIDATE_POINTS * (SIM_DOUBLINGS + SIM_ITERATIONS);
+
+}
@@ -0,0 +1,99 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#ifndef CAPACITY_H
+#define CAPACITY_H
+
+#include <QString>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Analytical estimate of how many cones per second one hose can keep up
+ * with, without running a simulation. Meant for ruling out hopeless regions
+ * of a parameter sweep before running it.
+ *
+ * The model is one hose cycle at saturation: finish filling a cone, travel
+ * to the next one (using the same ConstantSpeedDrive intercept geometry the
+ * planner uses), fill it. Travel is averaged over two pictures of where the
+ * next cone is, and the shorter one is used since the planner always takes
+ * the quickest cone:
+ *
+ * - Next in spawn order: u / rate upstream (u = belt speed), plus the random
+ *   offsets the drop area gives both cones.
+ * - Nearest neighbour: cones seen from the belt form a random field of
+ *   rate / (u * drop area height) per unit area, and the next cone is the
+ *   nearest upstream one.
+ *
+ * The rate is sustainable while rate * cycle <= 1, the cycle fits in the
+ * time a cone spends in the hose range, and the drop area can place cones
+ * that fast without overlap.
+ *
+ * It ignores the acceleration limits of AxisLimitedDrive, arrival
+ * burstiness and the planner's choice among several waiting cones, so check
+ * its error against the simulator with validate() before relying on it.
+ */
+//-----------------------------------------------------------------------------
+
+class CapacityModel {
+public:
+
+    /** The model's view of one parameter set at one rate. */
+    struct Estimate {
+        double travelTime;  /**< Expected hose travel per cone (seconds). */
+        double fillTime;    /**< Fill time per cone, in whole timesteps (seconds). */
+        double cycleTime;   /**< Hose time per cone (seconds). */
+        double window;      /**< Time a cone spends in the hose range (seconds). */
+        double dropRate;    /**< Most cones / second the drop area can place. */
+        double maxRate;     /**< Estimated max sustainable cones / second. */
+        Estimate () : travelTime(0), fillTime(0), cycleTime(0), window(0), dropRate(0), maxRate(0) { }
+    };
+
+    /** One validate() grid point. */
+    struct Check {
+        Simulator::Parameters params;   /**< Parameters tested. */
+        double predicted;               /**< Model's max rate. */
+        double simulated;               /**< Simulator's max rate. */
+        double bracket;                 /**< Width of the simulator's final search bracket. */
+        /** @return Relative error of the prediction. */
+        double error () const { return simulated > 0 ? (predicted - simulated) / simulated : 0.0; }
+    };
+
+    static Estimate estimate (const Simulator::Parameters &p);
+    static double cycleTime (const Simulator::Parameters &p, double rate, double *travel = NULL);
+    static double simulatedMaxRate (const Simulator::Parameters &p, double start, double seconds, double *bracket = NULL);
+    static QList<Check> validate (double seconds);
+    static int validateRuns ();
+
+};
+
+
+#endif // CAPACITY_H
@@ -26,7 +26,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 TARGET = cones
 TEMPLATE = app
@@ -35,10 +35,35 @@ TEMPLATE = app
 SOURCES += main.cpp\
         mainwindow.cpp \
     simulator.cpp \
-    simulatorview.cpp
+    simulatorview.cpp \
+    arrivals.cpp \
+    hosedrive.cpp \
+    controlloop.cpp \
+    latencystats.cpp \
+    plantlink.cpp \
+    standincontroller.cpp \
+    frameexporter.cpp \
+    scenarios.cpp \
+    tracelog.cpp \
+    forecast.cpp \
+    batchenv.cpp \
+    capacity.cpp
 
 HEADERS  += mainwindow.h \
     simulator.h \
-    simulatorview.h
+    simulatorview.h \
+    arrivals.h \
+    hosedrive.h \
+    rng.h \
+    controlloop.h \
+    latencystats.h \
+    plantlink.h \
+    standincontroller.h \
+    frameexporter.h \
+    scenarios.h \
+    tracelog.h \
+    forecast.h \
+    batchenv.h \
+    capacity.h
 
 FORMS    += mainwindow.ui
@@ -0,0 +1,137 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "controlloop.h"
+#include "latencystats.h"
+#include <QElapsedTimer>
+
+#define SPIN_NSECS  200000  /**< Busy wait this long before a deadline instead of sleeping. */
+
+
+static const double REPORT_PERCENTILES[4] = { 0.5, 0.99, 0.999, 1.0 }; /**< Report::latency / jitter entries. */
+
+
+ControlLoop::Report::Report () :
+    ticks(0),
+    overruns(0),
+    skipped(0),
+    degraded(0),
+    period(0),
+    passed(false)
+{
+
+    for (int n = 0; n < 4; ++ n)
+        latency[n] = jitter[n] = 0.0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor.
+ *
+ * @param   sim     Simulator to drive.
+ * @param   ticks   Number of ticks to run.
+ */
+//-----------------------------------------------------------------------------
+
+ControlLoop::ControlLoop (Simulator *sim, int ticks, QObject *parent) :
+    QThread(parent),
+    sim_(sim),
+    ticks_(ticks),
+    period_(sim->params().timestep),
+    planFraction_(0.5),
+    allowedOverruns_(0)
+{
+
+    setObjectName("ControlLoop");
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The loop. Ticks are released on a fixed grid of start + k * period; we
+ * sleep until just before a release and spin the rest of the way since sleep
+ * granularity is poor. A tick overruns if it finishes after the next release
+ * time, and then the releases it ran past are skipped (and counted) so the
+ * next tick starts on time rather than late.
+ */
+//-----------------------------------------------------------------------------
+
+void ControlLoop::run () {
+
+    qint64 period = qMax((qint64)1, (qint64)(period_ * 1e9));
+    LatencySamples latency(ticks_), jitter(ticks_);
+    Report r;
+    QElapsedTimer clock;
+
+    clock.start();
+    qint64 release = clock.nsecsElapsed() + period;
+
+    for (int n = 0; n < ticks_; ++ n) {
+
+        qint64 now = clock.nsecsElapsed();
+        if (release - now > SPIN_NSECS)
+            usleep((release - now - SPIN_NSECS) / 1000);
+        while ((now = clock.nsecsElapsed()) < release)
+            ;
+
+        qint64 deadline = release + period;
+        sim_->setPlanBudget(qMax((qint64)1, (qint64)((deadline - now) * planFraction_)));
+        sim_->update();
+        qint64 done = clock.nsecsElapsed();
+
+        jitter.add(now - release);
+        latency.add(done - now);
+        if (sim_->lastStepDegraded())
+            ++ r.degraded;
+
+        release = deadline;
+        if (done > deadline) {
+            qint64 missed = (done - deadline) / period + 1;
+            ++ r.overruns;
+            r.skipped += (int)missed;
+            release += missed * period;
+        }
+
+    }
+
+    sim_->setPlanBudget(0);
+
+    r.ticks = ticks_;
+    r.period = period / 1000.0;
+    for (int n = 0; n < 4; ++ n) {
+        r.latency[n] = latency.percentile(REPORT_PERCENTILES[n]);
+        r.jitter[n] = jitter.percentile(REPORT_PERCENTILES[n]);
+    }
+    r.passed = (r.overruns <= allowedOverruns_);
+    report_ = r;
+
+}
@@ -0,0 +1,104 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef CONTROLLOOP_H
+#define CONTROLLOOP_H
+
+#include <QThread>
+#include <QVector>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Runs a Simulator as a hard real-time control loop instead of from a QTimer.
+ * Ticks are released at fixed absolute deadlines on the monotonic clock
+ * (QElapsedTimer), so lateness doesn't accumulate, and the loop runs in its
+ * own time critical thread. A tick that overruns makes the loop skip to the
+ * next period boundary, like a real controller dropping frames, instead of
+ * running the late ticks back to back. Every tick's wake-up jitter and compute latency
+ * are recorded and summarized in a Report at the end.
+ *
+ * Each tick gives the simulator's planner whatever is left of the period
+ * (times planFraction) as its budget, see Simulator::setPlanBudget(), so with
+ * lots of cones the planner degrades instead of blowing the deadline.
+ *
+ * The simulator must not be touched by anything else while the loop runs.
+ */
+//-----------------------------------------------------------------------------
+
+class ControlLoop : public QThread {
+    Q_OBJECT
+
+public:
+
+    /** Results. Times are in microseconds. */
+    struct Report {
+        int ticks;              /**< Ticks run. */
+        int overruns;           /**< Ticks that finished after their deadline. */
+        int skipped;            /**< Releases skipped because of overruns. */
+        int degraded;           /**< Ticks where the planner ran out of budget. */
+        double period;          /**< Tick period. */
+        double latency[4];      /**< Compute time p50, p99, p99.9, max. */
+        double jitter[4];       /**< Wake-up lateness p50, p99, p99.9, max. */
+        bool passed;            /**< True if overruns <= allowed overruns. */
+        Report ();
+    };
+
+    ControlLoop (Simulator *sim, int ticks, QObject *parent = 0);
+
+    /** Tick period in seconds. Defaults to the simulator timestep. */
+    void setPeriod (double seconds) { period_ = seconds; }
+
+    /** Fraction of the remaining period the planner may use. Default 0.5. */
+    void setPlanFraction (double f) { planFraction_ = f; }
+
+    /** Number of overruns still considered a pass. Default 0. */
+    void setAllowedOverruns (int n) { allowedOverruns_ = n; }
+
+    /** @return Results; valid once the thread has finished. */
+    const Report & report () const { return report_; }
+
+protected:
+
+    void run ();
+
+private:
+
+    Simulator *sim_;        /**< Simulator being driven. */
+    int ticks_;             /**< Number of ticks to run. */
+    double period_;         /**< Tick period (seconds). */
+    double planFraction_;   /**< Planner share of remaining period. */
+    int allowedOverruns_;   /**< Overruns allowed for a pass. */
+    Report report_;         /**< Results. */
+
+};
+
+
+#endif // CONTROLLOOP_H
@@ -0,0 +1,213 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#include "forecast.h"
+#include <QtCore/QtConcurrentMap>
+#include <QTextStream>
+#include "tracelog.h"
+
+#define FORECAST_RUNS       8       /**< Default runs per forecast. */
+#define FORECAST_SECONDS    600.0   /**< Default forecast length (seconds). */
+#define CANCEL_CHECK_STEPS  256     /**< Steps between cancellation checks. */
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  One line summary, e.g. for a label.
+ */
+//-----------------------------------------------------------------------------
+
+QString Forecast::Result::toString () const {
+
+    QString str;
+    QTextStream out(&str);
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(1);
+    out << "Next " << seconds / 60.0 << " min: "
+        << fillRatio * 100.0 << "% filled (" << fillMin * 100.0 << "-" << fillMax * 100.0 << "%), "
+        << missRate << " missed/min";
+
+    return str;
+
+}
+
+
+Forecast::Forecast (QObject *parent) :
+    QObject(parent),
+    runs_(FORECAST_RUNS),
+    seconds_(FORECAST_SECONDS),
+    seed_(1),
+    serial_(new QAtomicInt(0))
+{
+
+    connect(&watcher_, SIGNAL(finished()), SLOT(collect()));
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Destructor. Cancels any forecast in progress, and waits for the runs of
+ * every forecast started (cancelled ones can still be winding down) to
+ * stop.
+ */
+//-----------------------------------------------------------------------------
+
+Forecast::~Forecast () {
+
+    cancel();
+    foreach (QFuture<Run> future, pending_)
+        future.waitForFinished();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Start a new forecast from sim's current state, cancelling the current one.
+ * sim is only read here (to clone it); it can carry on running right away.
+ * The clones keep their per-cone passes serial: the runs already fill the
+ * thread pool, and nested blocking maps would only tie up pool threads.
+ */
+//-----------------------------------------------------------------------------
+
+void Forecast::start (const Simulator &sim) {
+
+    cancel();
+
+    QList<Job> jobs;
+    for (int n = 0; n < runs_; ++ n) {
+        Job job;
+        job.sim = sim.clone();
+        job.sim->setSeed(seed_ ++);
+        job.sim->setPlanBudget(0);
+        job.sim->setParallelThreshold(0);
+        job.seconds = seconds_;
+        job.serial = serial_;
+        job.mine = *serial_;
+        jobs.append(job);
+    }
+
+    for (int n = pending_.size() - 1; n >= 0; -- n)
+        if (pending_[n].isFinished())
+            pending_.removeAt(n);
+
+    QFuture<Run> future = QtConcurrent::mapped(jobs, &Forecast::runJob);
+    pending_.append(future);
+    watcher_.setFuture(future);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Cancel the current forecast, if any. Doesn't wait. The runs aren't
+ * cancelled through the future since every job has to run to delete its
+ * Simulator; instead they see the new serial number and return early.
+ */
+//-----------------------------------------------------------------------------
+
+void Forecast::cancel () {
+
+    serial_->fetchAndAddOrdered(1);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * One run, on a pool thread. Gives up as soon as the forecast it belongs to
+ * is cancelled.
+ */
+//-----------------------------------------------------------------------------
+
+Forecast::Run Forecast::runJob (const Job &job) {
+
+    TRACE_SPAN("Forecast::runJob");
+
+    Run run;
+    run.serial = job.mine;
+    Simulator::Stats before = job.sim->stats();
+    int steps = (int)(job.seconds / job.sim->params().timestep + 0.5);
+
+    for (int n = 0; n < steps; ++ n) {
+        if (n % CANCEL_CHECK_STEPS == 0 && *job.serial != job.mine) {
+            run.cancelled = true;
+            break;
+        }
+        job.sim->update();
+    }
+
+    const Simulator::Stats &after = job.sim->stats();
+    run.stats.spawned = after.spawned - before.spawned;
+    run.stats.filled = after.filled - before.filled;
+    run.stats.missed = after.missed - before.missed;
+    run.stats.blocked = after.blocked - before.blocked;
+    run.stats.completed = after.completed - before.completed;
+    run.stats.escaped = after.escaped - before.escaped;
+
+    delete job.sim;
+    return run;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Combines the runs of a finished forecast and reports them. Drops them if
+ * the forecast was cancelled, including runs that got past their last
+ * cancellation check before it was.
+ */
+//-----------------------------------------------------------------------------
+
+void Forecast::collect () {
+
+    Result r;
+    r.seconds = seconds_;
+
+    foreach (const Run &run, watcher_.future().results()) {
+        if (run.cancelled || run.serial != *serial_)
+            return;
+        double ratio = run.stats.fillRatio();
+        r.fillMin = (r.runs ? qMin(r.fillMin, ratio) : ratio);
+        r.fillMax = (r.runs ? qMax(r.fillMax, ratio) : ratio);
+        r.fillRatio += ratio;
+        r.missRate += run.stats.missed / (seconds_ / 60.0);
+        ++ r.runs;
+    }
+
+    if (r.runs) {
+        r.fillRatio /= r.runs;
+        r.missRate /= r.runs;
+        emit finished(r);
+    }
+
+}
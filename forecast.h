@@ -0,0 +1,125 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QList>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QString>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Looks ahead from the current simulation state: clones the Simulator a few
+ * times with different seeds and runs the copies faster than real time on
+ * the global QThreadPool, then reports how the fill ratio and miss rate are
+ * likely to turn out. Starting a new forecast cancels the one in progress;
+ * its runs stop at their next check and its results are never reported.
+ */
+//-----------------------------------------------------------------------------
+
+class Forecast : public QObject {
+    Q_OBJECT
+
+public:
+
+    /** What the runs predicted, over the forecast period only. */
+    struct Result {
+        int runs;           /**< Number of runs. */
+        double seconds;     /**< Simulated length of each run. */
+        double fillRatio;   /**< Mean fill ratio. */
+        double fillMin;     /**< Worst run's fill ratio. */
+        double fillMax;     /**< Best run's fill ratio. */
+        double missRate;    /**< Mean missed cones per minute. */
+        Result () : runs(0), seconds(0), fillRatio(0), fillMin(0), fillMax(0), missRate(0) { }
+        QString toString () const;
+    };
+
+    explicit Forecast (QObject *parent = 0);
+    ~Forecast ();
+
+    /** Set the number of runs (seeds) per forecast. */
+    void setRuns (int runs) { runs_ = runs; }
+
+    /** Set the simulated length of each run (seconds). */
+    void setSeconds (double seconds) { seconds_ = seconds; }
+
+    void start (const Simulator &sim);
+    void cancel ();
+
+    /** @return True while a forecast is running. */
+    bool running () const { return watcher_.isRunning(); }
+
+signals:
+
+    /** A forecast completed. Not emitted for cancelled forecasts. */
+    void finished (const Forecast::Result &result);
+
+private slots:
+
+    void collect ();
+
+private:
+
+    /** The outcome of one run. */
+    struct Run {
+        bool cancelled;             /**< Stopped early, ignore. */
+        int serial;                 /**< Forecast number it belongs to. */
+        Simulator::Stats stats;     /**< Totals over the run only. */
+        Run () : cancelled(false), serial(0) { }
+    };
+
+    /** One run to do. */
+    struct Job {
+        Simulator *sim;                     /**< Clone to run (the job deletes it). */
+        double seconds;                     /**< How long to run it. */
+        QSharedPointer<QAtomicInt> serial;  /**< Current forecast number. */
+        int mine;                           /**< This forecast's number. */
+    };
+
+    int runs_;                          /**< Runs per forecast. */
+    double seconds_;                    /**< Run length. */
+    quint64 seed_;                      /**< Next seed. */
+    QSharedPointer<QAtomicInt> serial_; /**< Bumped to cancel, shared with jobs. */
+    QFutureWatcher<Run> watcher_;       /**< Current forecast. */
+    QList<QFuture<Run> > pending_;      /**< Every forecast that may still be
+                                             running, cancelled ones included. */
+
+    static Run runJob (const Job &job);
+
+};
+
+
+#endif // FORECAST_H
@@ -0,0 +1,133 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "frameexporter.h"
+#include "simulatorview.h"
+#include "tracelog.h"
+#include <QImage>
+#include <QPainter>
+#include <QDir>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QFuture>
+
+typedef QSharedPointer<Simulator::Snapshot> SnapshotPtr;
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Draw and save one frame. Runs on a pool thread.
+ *
+ * @return  True if the image was saved.
+ */
+//-----------------------------------------------------------------------------
+
+static bool renderFrame (SnapshotPtr snap, QString filename, QSize size, QString format) {
+
+    TRACE_SPAN("FrameExporter::renderFrame");
+
+    double xmin, xmax;
+    SimulatorView::autoBounds(snap->params, xmin, xmax);
+
+    QImage image(size, QImage::Format_RGB32);
+    QPainter p(&image);
+    SimulatorView::render(p, image.rect(), snap->params, snap->hose, snap->cones, xmin, xmax);
+    p.end();
+
+    return image.save(filename, format.toAscii().constData());
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor.
+ *
+ * @param   dir     Output directory. Created if needed.
+ * @param   size    Frame size in pixels.
+ * @param   format  Image format, anything QImage can write. Also used as the
+ *                  file extension.
+ */
+//-----------------------------------------------------------------------------
+
+FrameExporter::FrameExporter (const QString &dir, const QSize &size, const QString &format) :
+    dir_(dir),
+    size_(size),
+    format_(format),
+    frameskip_(1),
+    lookahead_(4 * qMax(1, QThread::idealThreadCount()))
+{
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Run sim and export the given number of frames. Like MainWindow, each frame
+ * is drawn after its steps are taken.
+ *
+ * @return  False if a frame couldn't be written (see errorString()).
+ */
+//-----------------------------------------------------------------------------
+
+bool FrameExporter::run (Simulator &sim, int frames) {
+
+    QQueue<QFuture<bool> > inflight;
+    bool ok = true;
+
+    if (!QDir().mkpath(dir_)) {
+        error_ = "could not create " + dir_;
+        return false;
+    }
+
+    for (int n = 0; n < frames && ok; ++ n) {
+
+        for (int k = 0; k < frameskip_; ++ k)
+            sim.update();
+
+        SnapshotPtr snap(new Simulator::Snapshot(sim));
+        QString filename = QString("%1/frame%2.%3").arg(dir_).arg(n, 6, 10, QChar('0')).arg(format_);
+
+        if (inflight.size() >= lookahead_)
+            ok = inflight.dequeue().result();
+
+        inflight.enqueue(QtConcurrent::run(renderFrame, snap, filename, size_, format_));
+
+    }
+
+    while (!inflight.isEmpty())
+        ok = inflight.dequeue().result() && ok;
+
+    if (!ok)
+        error_ = "could not write frames to " + dir_;
+
+    return ok;
+
+}
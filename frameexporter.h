@@ -0,0 +1,81 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef FRAMEEXPORTER_H
+#define FRAMEEXPORTER_H
+
+#include <QString>
+#include <QSize>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Exports a run as a numbered image sequence (frame000000.png etc.) without a
+ * display, for turning into review videos with e.g.:
+ *
+ *     ffmpeg -framerate 50 -i frame%06d.png run.mp4
+ *
+ * The simulator runs on the calling thread and hands Simulator::Snapshots to
+ * the global QThreadPool, where each frame is drawn with
+ * SimulatorView::render() into a QImage and encoded. Up to lookahead frames
+ * are in flight at once, so the simulation stays ahead of the renderers but
+ * memory stays bounded.
+ */
+//-----------------------------------------------------------------------------
+
+class FrameExporter {
+public:
+
+    FrameExporter (const QString &dir, const QSize &size, const QString &format = "png");
+
+    /** Simulator steps per exported frame. Default 1. */
+    void setFrameSkip (int steps) { frameskip_ = steps; }
+
+    /** Max frames in flight. Default is 4 per core. */
+    void setLookahead (int frames) { lookahead_ = frames; }
+
+    bool run (Simulator &sim, int frames);
+
+    /** @return Description of the last error. */
+    QString errorString () const { return error_; }
+
+private:
+
+    QString dir_;       /**< Output directory. */
+    QSize size_;        /**< Frame size. */
+    QString format_;    /**< Image format / file extension. */
+    int frameskip_;     /**< Steps per frame. */
+    int lookahead_;     /**< Max frames in flight. */
+    QString error_;     /**< Last error. */
+
+};
+
+
+#endif // FRAMEEXPORTER_H
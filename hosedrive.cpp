@@ -0,0 +1,373 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "hosedrive.h"
+#include <cmath>
+#include <QtGlobal>
+
+#define ARRIVE_EPSILON  1e-3    /**< Position tolerance for AxisLimitedDrive arrival. */
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Given cone position and velocity, and hose position and speed, calculates
+ * the point that the hose can intercept the cone and the time it will take to
+ * get there. Math is from http://stackoverflow.com/a/2249237.
+ *
+ * @param   cone        Cone position.
+ * @param   coneVel     Cone velocity (per second).
+ * @param   hose        Hose head position.
+ * @param   hoseSpeed   Hose head speed (per second).
+ * @param   tout        If not NULL, will contain movement time.
+ * @return  The interception point, or a null vector if no solution exists. The
+ *          hose direction and velocity can be calculated from this, hose, and
+ *          tout.
+ */
+//-----------------------------------------------------------------------------
+
+static QVector2D intercept (const QVector2D &cone,
+                            const QVector2D &coneVel,
+                            const QVector2D &hose,
+                            double hoseSpeed,
+                            double *tout)
+{
+
+    /* from http://stackoverflow.com/a/2249237
+    a := sqr(target.velocityX) + sqr(target.velocityY) - sqr(projectile_speed)
+    b := 2 * (target.velocityX * (target.startX - cannon.X)
+              + target.velocityY * (target.startY - cannon.Y))
+    c := sqr(target.startX - cannon.X) + sqr(target.startY - cannon.Y)
+    disc := sqr(b) - 4 * a * c
+    t1 := (-b + sqrt(disc)) / (2 * a)
+    t2 := (-b - sqrt(disc)) / (2 * a)
+    aim.X := t * target.velocityX + target.startX
+    aim.Y := t * target.velocityY + target.startY
+    */
+
+    QVector2D hoseToCone = cone - hose;
+
+    double a = coneVel.lengthSquared() - hoseSpeed * hoseSpeed;
+    double b = 2.0 * QVector2D::dotProduct(coneVel, hoseToCone);
+    double c = hoseToCone.lengthSquared();
+    double disc = b * b - 4 * a * c;
+
+    if (disc < 0.0)
+        return QVector2D();
+
+    double sqrt_disc = sqrt(disc);
+    double t1 = (-b + sqrt_disc) / (2.0 * a);
+    double t2 = (-b - sqrt_disc) / (2.0 * a);
+    double t;
+
+    if (t1 < 0.0)
+        t = t2;
+    else if (t2 < 0.0)
+        t = t1;
+    else
+        t = qMin(t1, t2);
+
+    if (t < 0.0)
+        return QVector2D();
+
+    if (tout)
+        *tout = t;
+
+    return coneVel * t + cone;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Minimum time for one axis to cover displacement d and end at rest, starting
+ * with velocity v, with acceleration limited to accel and velocity limited to
+ * [vlo, vhi]. This is the usual triangle/trapezoid profile; the asymmetric
+ * velocity limits are what you get when solving in the frame of a moving
+ * target, which is how axisTime() is used.
+ *
+ * @return  The time, or a negative value if the velocity limits don't allow
+ *          moving in the required direction.
+ */
+//-----------------------------------------------------------------------------
+
+static double axisTime (double d, double v, double accel, double vlo, double vhi) {
+
+    v = qBound(vlo, v, vhi);
+
+    // if braking right now would overshoot, the move is in the -ve direction;
+    // mirror it so we only have to handle +ve.
+    if (d < v * fabs(v) / (2.0 * accel)) {
+        d = -d;
+        v = -v;
+        double t = vlo;
+        vlo = -vhi;
+        vhi = -t;
+    }
+
+    if (d == 0.0 && v == 0.0)
+        return 0.0;
+    if (vhi <= 0.0)
+        return -1.0;
+
+    // accelerate to peak then brake to 0, cruising at vhi if the peak is
+    // above it.
+    double peak = sqrt((2.0 * accel * d + v * v) / 2.0);
+    double cruise = 0.0;
+    if (peak > vhi) {
+        peak = vhi;
+        cruise = (d - (2.0 * vhi * vhi - v * v) / (2.0 * accel)) / vhi;
+    }
+
+    return (peak - v) / accel + peak / accel + cruise;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Advance one axis by dt, steering towards a target moving with constant
+ * velocity. Uses the (discretized) braking curve of the time-optimal profile
+ * in the target's frame, so it tracks what axisTime() predicts.
+ *
+ * @param   x       Axis position (in/out).
+ * @param   v       Axis velocity (in/out).
+ * @param   tx      Target position.
+ * @param   tv      Target velocity.
+ * @param   vmax    Axis speed limit.
+ * @param   accel   Axis acceleration limit.
+ * @param   dt      Time step.
+ * @return  True if the axis is on the target and moving with it.
+ */
+//-----------------------------------------------------------------------------
+
+static bool axisStep (double &x, double &v, double tx, double tv,
+                      double vmax, double accel, double dt)
+{
+
+    double e = tx - x;
+    double r = v - tv;
+    double dvmax = accel * dt;
+
+    if (fabs(e) <= ARRIVE_EPSILON && fabs(r) <= dvmax) {
+        x = tx + tv * dt;
+        v = tv;
+        return true;
+    }
+
+    // fastest relative approach speed this step that still lets us stop on
+    // the target, accounting for the distance covered during the step itself
+    double s = e < 0.0 ? -1.0 : 1.0;
+    double q = 2.0 * accel * fabs(e) - accel * s * r * dt;
+    double want = q > 0.0 ? 0.5 * (sqrt(dvmax * dvmax + 4.0 * q) - dvmax) : 0.0;
+    want = qBound(-vmax - tv, s * want, vmax - tv);
+
+    double vnew = qBound(-vmax, v + qBound(-dvmax, want - r, dvmax), vmax);
+    x += 0.5 * (v + vnew) * dt;
+    v = vnew;
+
+    return false;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Head starts at the origin; use moveTo(..., true) to place it.
+ *
+ * @param   speed   Movement speed (units / second).
+ */
+//-----------------------------------------------------------------------------
+
+ConstantSpeedDrive::ConstantSpeedDrive (double speed) :
+    speed_(speed),
+    arrived_(true)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * If the target is moving the head is sent to the interception point, which
+ * is what the original updateHose() did.
+ */
+//-----------------------------------------------------------------------------
+
+void ConstantSpeedDrive::moveTo (const QVector2D &pos, const QVector2D &vel, bool instant) {
+
+    if (instant) {
+        pos_ = pos;
+        dest_ = pos;
+        arrived_ = true;
+        return;
+    }
+
+    dest_ = pos;
+    if (!vel.isNull()) {
+        QVector2D fillpoint = intercept(pos, vel, pos_, speed_, NULL);
+        if (!fillpoint.isNull())
+            dest_ = fillpoint;
+    }
+    // note: lazy logic will immediately set arrived = true again if we're
+    // already there but who cares.
+    arrived_ = false;
+
+}
+
+
+void ConstantSpeedDrive::update (double dt) {
+
+    if (!arrived_) {
+        QVector2D todest = dest_ - pos_;
+        double dist = speed_ * dt;
+        if (dist > todest.length()) {
+            pos_ = dest_;
+            arrived_ = true;
+        } else {
+            pos_ += todest.normalized() * dist;
+        }
+    }
+
+}
+
+
+double ConstantSpeedDrive::calcTime (const QVector2D &pos) const {
+
+    return (pos - pos_).length() / speed_;
+
+}
+
+
+QVector2D ConstantSpeedDrive::calcIntercept (const QVector2D &target,
+                                             const QVector2D &targetVel,
+                                             double *tout) const
+{
+
+    return intercept(target, targetVel, pos_, speed_, tout);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Head starts at rest at the origin; use moveTo(..., true) to
+ * place it.
+ *
+ * @param   limits  Axis limits. Accelerations must be > 0.
+ */
+//-----------------------------------------------------------------------------
+
+AxisLimitedDrive::AxisLimitedDrive (const Limits &limits) :
+    lim_(limits),
+    arrived_(true)
+{
+}
+
+
+void AxisLimitedDrive::moveTo (const QVector2D &pos, const QVector2D &vel, bool instant) {
+
+    tpos_ = pos;
+    tvel_ = vel;
+
+    if (instant) {
+        pos_ = pos;
+        vel_ = vel;
+        arrived_ = true;
+    } else {
+        arrived_ = (pos_ - tpos_).length() <= ARRIVE_EPSILON && (vel_ - tvel_).isNull();
+    }
+
+}
+
+
+void AxisLimitedDrive::update (double dt) {
+
+    double x = pos_.x(), y = pos_.y(), vx = vel_.x(), vy = vel_.y();
+
+    bool ax = axisStep(x, vx, tpos_.x(), tvel_.x(), lim_.maxSpeed.x(), lim_.maxAccel.x(), dt);
+    bool ay = axisStep(y, vy, tpos_.y(), tvel_.y(), lim_.maxSpeed.y(), lim_.maxAccel.y(), dt);
+
+    pos_ = QVector2D(x, y);
+    vel_ = QVector2D(vx, vy);
+    tpos_ += tvel_ * dt;
+    arrived_ = ax && ay;
+
+}
+
+
+double AxisLimitedDrive::calcTime (const QVector2D &pos) const {
+
+    double t;
+    calcIntercept(pos, QVector2D(), &t);
+    return t;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * In the target's frame each axis just has to come to rest at the target,
+ * with its velocity limits shifted by the target's velocity; that is exactly
+ * axisTime(). Once an axis has caught up it can track the target, so the
+ * intercept time is the slower of the two axes.
+ */
+//-----------------------------------------------------------------------------
+
+QVector2D AxisLimitedDrive::calcIntercept (const QVector2D &target,
+                                           const QVector2D &targetVel,
+                                           double *tout) const
+{
+
+    QVector2D d = target - pos_;
+    QVector2D r = vel_ - targetVel;
+
+    // can't keep up with it once we get there
+    if (fabs(targetVel.x()) > lim_.maxSpeed.x() || fabs(targetVel.y()) > lim_.maxSpeed.y()) {
+        if (tout)
+            *tout = -1.0;
+        return QVector2D();
+    }
+
+    double tx = axisTime(d.x(), r.x(), lim_.maxAccel.x(),
+                         -lim_.maxSpeed.x() - targetVel.x(), lim_.maxSpeed.x() - targetVel.x());
+    double ty = axisTime(d.y(), r.y(), lim_.maxAccel.y(),
+                         -lim_.maxSpeed.y() - targetVel.y(), lim_.maxSpeed.y() - targetVel.y());
+
+    if (tx < 0.0 || ty < 0.0) {
+        if (tout)
+            *tout = -1.0;
+        return QVector2D();
+    }
+
+    double t = qMax(tx, ty);
+    if (tout)
+        *tout = t;
+
+    return targetVel * t + target;
+
+}
@@ -0,0 +1,181 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef HOSEDRIVE_H
+#define HOSEDRIVE_H
+
+#include <QVector2D>
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Hose head motion model. Simulator::updateHose() decides where the hose
+ * should go; the drive decides how it gets there, and answers the planning
+ * questions (how long will it take, where can it catch a cone) using the same
+ * model so plans and motion agree.
+ *
+ * Targets are given as a point moving with constant velocity (a cone on the
+ * belt, or a fixed point with zero velocity). A drive has "arrived" once its
+ * head sits on the target and is moving along with it.
+ */
+//-----------------------------------------------------------------------------
+
+class HoseDrive {
+public:
+
+    virtual ~HoseDrive () { }
+
+    /**
+     * Set the current target.
+     *
+     * @param   pos     Target position now.
+     * @param   vel     Target velocity (per second).
+     * @param   instant If true, teleport there (and match vel) immediately.
+     */
+    virtual void moveTo (const QVector2D &pos, const QVector2D &vel, bool instant) = 0;
+
+    /** Advance the head by dt seconds towards the target. */
+    virtual void update (double dt) = 0;
+
+    /** @return True if the head has reached the target. */
+    virtual bool arrived () const = 0;
+
+    /** @return Current head position. */
+    virtual QVector2D pos () const = 0;
+
+    /** @return Time to move from the current state to pos and stop there. */
+    virtual double calcTime (const QVector2D &pos) const = 0;
+
+    /**
+     * Calculate where and when the head can catch a moving target, starting
+     * from its current state.
+     *
+     * @param   target      Target position now.
+     * @param   targetVel   Target velocity (per second).
+     * @param   tout        If not NULL, will contain movement time.
+     * @return  The interception point, or a null vector if no solution exists.
+     */
+    virtual QVector2D calcIntercept (const QVector2D &target,
+                                     const QVector2D &targetVel,
+                                     double *tout) const = 0;
+
+    /** Set the top speed (Parameters::hoseSpeed). */
+    virtual void setSpeed (double speed) = 0;
+
+    /** @return A copy in the same state, for Simulator::clone(). */
+    virtual HoseDrive * clone () const = 0;
+
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The original model: the head moves in a straight line at constant speed
+ * in any direction and changes velocity instantly. It heads for the fixed
+ * interception point computed when the target was set.
+ */
+//-----------------------------------------------------------------------------
+
+class ConstantSpeedDrive : public HoseDrive {
+public:
+    explicit ConstantSpeedDrive (double speed);
+    void moveTo (const QVector2D &pos, const QVector2D &vel, bool instant);
+    void update (double dt);
+    bool arrived () const { return arrived_; }
+    QVector2D pos () const { return pos_; }
+    double calcTime (const QVector2D &pos) const;
+    QVector2D calcIntercept (const QVector2D &target, const QVector2D &targetVel, double *tout) const;
+    void setSpeed (double speed) { speed_ = speed; }
+    HoseDrive * clone () const { return new ConstantSpeedDrive(*this); }
+private:
+    double speed_;      /**< Movement speed. */
+    QVector2D pos_;     /**< Current position. */
+    QVector2D dest_;    /**< Fixed movement destination. */
+    bool arrived_;      /**< Arrived at dest_? */
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * A gantry: X and Y are driven independently, each with its own velocity and
+ * acceleration limit. Motion on each axis follows the time-optimal
+ * (bang-bang, with cruise at the velocity limit) profile towards the moving
+ * target, and calcIntercept() solves the same profile in closed form, so
+ * planning costs about the same as the constant speed model.
+ *
+ * Jerk limits are left out on purpose. Take a rest-to-rest move on one axis
+ * that reaches the speed and acceleration limits V and A. Its time-optimal
+ * profile takes D / V + V / A. With a jerk limit J the S-curve version
+ * takes D / V + V / A + A / J, the same move plus one constant. For gantry
+ * values (A = 40, J of a few thousand) A / J is around 10 ms. That is less
+ * than one 20 ms simulation step, so neither the planner's choice between
+ * cones nor the step on which the hose arrives changes. Short moves that
+ * never reach A lose even less. If a drive needs it, the constant can be
+ * folded into the acceleration limit (a slightly lower maxAccel) rather than
+ * paying for an S-curve intercept solver on every candidate cone.
+ */
+//-----------------------------------------------------------------------------
+
+class AxisLimitedDrive : public HoseDrive {
+public:
+
+    /** Per-axis limits. */
+    struct Limits {
+        QVector2D maxSpeed;     /**< Max speed of each axis (units / second). */
+        QVector2D maxAccel;     /**< Max acceleration of each axis (units / second^2). */
+    };
+
+    explicit AxisLimitedDrive (const Limits &limits);
+    void moveTo (const QVector2D &pos, const QVector2D &vel, bool instant);
+    void update (double dt);
+    bool arrived () const { return arrived_; }
+    QVector2D pos () const { return pos_; }
+    double calcTime (const QVector2D &pos) const;
+    QVector2D calcIntercept (const QVector2D &target, const QVector2D &targetVel, double *tout) const;
+    /** Sets the speed limit of both axes. */
+    void setSpeed (double speed) { lim_.maxSpeed = QVector2D(speed, speed); }
+    HoseDrive * clone () const { return new AxisLimitedDrive(*this); }
+    /** @return Current limits. */
+    const Limits & limits () const { return lim_; }
+    /** @return Current head velocity. */
+    QVector2D velocity () const { return vel_; }
+
+private:
+
+    Limits lim_;        /**< Axis limits. */
+    QVector2D pos_;     /**< Current position. */
+    QVector2D vel_;     /**< Current velocity. */
+    QVector2D tpos_;    /**< Target position. */
+    QVector2D tvel_;    /**< Target velocity. */
+    bool arrived_;      /**< Arrived at (and tracking) target? */
+
+};
+
+
+#endif // HOSEDRIVE_H
@@ -0,0 +1,265 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "latencystats.h"
+#include <QtAlgorithms>
+#include <QTextStream>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor.
+ *
+ * @param   reserve     Expected number of samples.
+ */
+//-----------------------------------------------------------------------------
+
+LatencySamples::LatencySamples (int reserve) :
+    sorted_(true)
+{
+
+    samples_.reserve(reserve);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @param   p   Percentile, 0 to 1 (1 = max).
+ * @return  The p-th percentile, in microseconds, or 0 if there are no samples.
+ */
+//-----------------------------------------------------------------------------
+
+double LatencySamples::percentile (double p) {
+
+    if (samples_.isEmpty())
+        return 0.0;
+
+    if (!sorted_) {
+        qSort(samples_);
+        sorted_ = true;
+    }
+
+    int index = qBound(0, (int)(p * (samples_.size() - 1) + 0.5), samples_.size() - 1);
+    return samples_[index] / 1000.0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  "p50 x  p99 x  p99.9 x  max x us".
+ */
+//-----------------------------------------------------------------------------
+
+QString LatencySamples::summary () {
+
+    QString str;
+    QTextStream out(&str);
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(1);
+    out << "p50 " << percentile(0.5) << "  p99 " << percentile(0.99)
+        << "  p99.9 " << percentile(0.999) << "  max " << percentile(1.0) << " us";
+
+    return str;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor.
+ *
+ * @param   accuracy    Relative accuracy of quantiles (0.01 = 1%).
+ * @param   maxBins     Max bins kept. With 1% accuracy 2048 bins cover about
+ *                      18 orders of magnitude before anything is merged.
+ */
+//-----------------------------------------------------------------------------
+
+QuantileSketch::QuantileSketch (double accuracy, int maxBins) :
+    accuracy_(accuracy),
+    logGamma_(log((1.0 + accuracy) / (1.0 - accuracy))),
+    maxBins_(qMax(1, maxBins)),
+    offset_(0),
+    zeros_(0),
+    count_(0),
+    min_(0),
+    max_(0),
+    sum_(0)
+{
+}
+
+
+void QuantileSketch::add (double x) {
+
+    min_ = count_ ? qMin(min_, x) : x;
+    max_ = count_ ? qMax(max_, x) : x;
+    sum_ += x;
+    ++ count_;
+
+    if (x <= 0.0)
+        ++ zeros_;
+    else
+        addToBin((int)ceil(log(x) / logGamma_), 1);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Add n to bin index, growing the bin range as needed and folding the lowest
+ * bins together if it gets longer than maxBins_.
+ */
+//-----------------------------------------------------------------------------
+
+void QuantileSketch::addToBin (int index, quint64 n) {
+
+    if (bins_.isEmpty()) {
+        offset_ = index;
+        bins_.append(n);
+        return;
+    }
+
+    if (index < offset_) {
+        // extend downwards as far as allowed; anything lower lands in bin 0
+        int grow = qMin(offset_ - index, maxBins_ - bins_.size());
+        if (grow > 0) {
+            bins_.insert(0, grow, 0);
+            offset_ -= grow;
+        }
+        bins_[qMax(0, index - offset_)] += n;
+        return;
+    }
+
+    if (index >= offset_ + bins_.size()) {
+        bins_.resize(index - offset_ + 1);
+        int excess = bins_.size() - maxBins_;
+        if (excess > 0) {
+            for (int k = 0; k < excess; ++ k)
+                bins_[excess] += bins_[k];
+            bins_.remove(0, excess);
+            offset_ += excess;
+        }
+    }
+
+    bins_[index - offset_] += n;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Add everything from other. Both should have the same accuracy.
+ */
+//-----------------------------------------------------------------------------
+
+void QuantileSketch::merge (const QuantileSketch &other) {
+
+    if (!other.count_)
+        return;
+
+    min_ = count_ ? qMin(min_, other.min_) : other.min_;
+    max_ = count_ ? qMax(max_, other.max_) : other.max_;
+    sum_ += other.sum_;
+    count_ += other.count_;
+    zeros_ += other.zeros_;
+
+    // highest first, so the range only has to grow downwards once
+    for (int n = other.bins_.size() - 1; n >= 0; -- n)
+        if (other.bins_[n])
+            addToBin(other.offset_ + n, other.bins_[n]);
+
+}
+
+
+void QuantileSketch::clear () {
+
+    bins_.clear();
+    offset_ = 0;
+    zeros_ = count_ = 0;
+    min_ = max_ = sum_ = 0.0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @param   q   Quantile, 0 to 1.
+ * @return  Estimate of the q-th quantile, or 0 if empty.
+ */
+//-----------------------------------------------------------------------------
+
+double QuantileSketch::quantile (double q) const {
+
+    if (!count_)
+        return 0.0;
+
+    quint64 rank = (quint64)(qBound(0.0, q, 1.0) * (count_ - 1));
+    if (rank < zeros_)
+        return qMax(0.0, min_);
+
+    quint64 seen = zeros_;
+    for (int n = 0; n < bins_.size(); ++ n) {
+        seen += bins_[n];
+        if (seen > rank) {
+            // bin i holds (gamma^(i-1), gamma^i]; this is the point with
+            // equal relative error to both ends
+            double value = 2.0 * exp((offset_ + n) * logGamma_) / (1.0 + exp(logGamma_));
+            return qBound(min_, value, max_);
+        }
+    }
+
+    return max_;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @param   scale   Multiply values by this for display.
+ * @param   unit    Unit name for display.
+ * @return  "n x  p50 x  p99 x  p99.9 x  max x unit".
+ */
+//-----------------------------------------------------------------------------
+
+QString QuantileSketch::summary (double scale, const QString &unit) const {
+
+    QString str;
+    QTextStream out(&str);
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(2);
+    out << "n " << count_ << "  p50 " << quantile(0.5) * scale << "  p99 " << quantile(0.99) * scale
+        << "  p99.9 " << quantile(0.999) * scale << "  max " << max() * scale << " " << unit;
+
+    return str;
+
+}
@@ -0,0 +1,127 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QVector>
+#include <QString>
+#include <QtGlobal>
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Collects latency samples (in nanoseconds) and reports percentiles (in
+ * microseconds). Keeps every sample, so it's meant for bounded runs like a
+ * ControlLoop or PlantServer session.
+ */
+//-----------------------------------------------------------------------------
+
+class LatencySamples {
+public:
+
+    explicit LatencySamples (int reserve = 0);
+
+    /** Add a sample. */
+    void add (qint64 nsecs) { samples_.append(nsecs); sorted_ = false; }
+
+    /** @return Number of samples. */
+    int count () const { return samples_.size(); }
+
+    double percentile (double p);
+
+    QString summary ();
+
+private:
+
+    QVector<qint64> samples_;   /**< All samples. */
+    bool sorted_;               /**< Is samples_ currently sorted? */
+
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Streaming quantile sketch with relative error guarantees (the DDSketch
+ * scheme): values go into logarithmically sized bins, so any quantile comes
+ * back within +/- accuracy (relative) of the true value. Memory is capped at
+ * maxBins no matter how many values are added; if the range of values needs
+ * more bins than that, the lowest bins are merged, which only costs accuracy
+ * at the low end. Sketches with the same accuracy can be merged exactly,
+ * e.g. to combine parallel replicas.
+ *
+ * Meant for non-negative values (times). Values at or below zero are counted
+ * separately and report as 0.
+ */
+//-----------------------------------------------------------------------------
+
+class QuantileSketch {
+public:
+
+    explicit QuantileSketch (double accuracy = 0.01, int maxBins = 2048);
+
+    void add (double x);
+    void merge (const QuantileSketch &other);
+    void clear ();
+
+    double quantile (double q) const;
+
+    /** @return Number of values added. */
+    quint64 count () const { return count_; }
+
+    /** @return Smallest value added (0 if none). */
+    double min () const { return count_ ? min_ : 0.0; }
+
+    /** @return Largest value added (0 if none). */
+    double max () const { return count_ ? max_ : 0.0; }
+
+    /** @return Mean of values added (0 if none). */
+    double mean () const { return count_ ? sum_ / count_ : 0.0; }
+
+    QString summary (double scale = 1.0, const QString &unit = "s") const;
+
+private:
+
+    double accuracy_;       /**< Relative accuracy. */
+    double logGamma_;       /**< log of the bin growth factor. */
+    int maxBins_;           /**< Bin limit. */
+    QVector<quint64> bins_; /**< Counts; bins_[n] is bin index offset_ + n. */
+    int offset_;            /**< Bin index of bins_[0]. */
+    quint64 zeros_;         /**< Values <= 0. */
+    quint64 count_;         /**< Total values. */
+    double min_;            /**< Smallest value. */
+    double max_;            /**< Largest value. */
+    double sum_;            /**< Sum of values. */
+
+    void addToBin (int index, quint64 n);
+
+};
+
+
+#endif // LATENCYSTATS_H
@@ -27,10 +27,461 @@
 //=============================================================================
 
 #include <QtGui/QApplication>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QProcess>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QtAlgorithms>
+#include <cstring>
+#include <cstdio>
 #include "mainwindow.h"
+#include "controlloop.h"
+#include "plantlink.h"
+#include "standincontroller.h"
+#include "frameexporter.h"
+#include "scenarios.h"
+#include "tracelog.h"
+#include "batchenv.h"
+#include "capacity.h"
+#include "rng.h"
+#include <QtCore/QtConcurrentMap>
 
+#define LINK_TIMEOUT 5000   /**< Plant link timeout (ms). */
 
-int main (int argc, char *argv[]) {
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  The argument following name, or def if name isn't there or isn't
+ *          followed by a value.
+ */
+//-----------------------------------------------------------------------------
+
+static QString option (const QStringList &args, const QString &name, const QString &def = QString()) {
+
+    int index = args.indexOf(name);
+    if (index < 0 || index + 1 >= args.size() || args[index + 1].startsWith("--"))
+        return def;
+    return args[index + 1];
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Print a ControlLoop pass/fail report.
+ */
+//-----------------------------------------------------------------------------
+
+static void printReport (QTextStream &out, const ControlLoop::Report &r) {
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(1);
+    out << "ticks:     " << r.ticks << " @ " << r.period << " us\n";
+    out << "latency:   p50 " << r.latency[0] << "  p99 " << r.latency[1]
+        << "  p99.9 " << r.latency[2] << "  max " << r.latency[3] << " us\n";
+    out << "jitter:    p50 " << r.jitter[0] << "  p99 " << r.jitter[1]
+        << "  p99.9 " << r.jitter[2] << "  max " << r.jitter[3] << " us\n";
+    out << "overruns:  " << r.overruns << " (" << r.skipped << " releases skipped)\n";
+    out << "degraded:  " << r.degraded << "\n";
+    out << "result:    " << (r.passed ? "PASS" : "FAIL") << "\n";
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Headless real-time control loop mode:
+ *
+ *     cones --control-loop [seconds] [--period ms] [--allowed-overruns n]
+ *
+ * Runs the default simulation under ControlLoop and prints the latency
+ * report. Exit code is 0 on pass, 1 on fail.
+ */
+//-----------------------------------------------------------------------------
+
+static int controlLoopMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    bool secondsOk, periodOk;
+    double seconds = option(args, "--control-loop", "60").toDouble(&secondsOk);
+    double period = option(args, "--period", QString::number(1000.0 / FPS)).toDouble(&periodOk) / 1000.0;
+    if (!secondsOk || seconds <= 0.0) {
+        out << "control-loop: seconds must be a number greater than 0\n";
+        return 1;
+    }
+    if (!periodOk || period <= 0.0) {
+        out << "control-loop: --period must be a number greater than 0\n";
+        return 1;
+    }
+
+    Simulator sim(Simulator::defaults(1.0 / FPS));
+    ControlLoop loop(&sim, qMax(1, (int)(seconds / period + 0.5)));
+    loop.setPeriod(period);
+    loop.setAllowedOverruns(option(args, "--allowed-overruns", "0").toInt());
+    loop.start(QThread::TimeCriticalPriority);
+    loop.wait();
+
+    printReport(out, loop.report());
+    return loop.report().passed ? 0 : 1;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Headless plant mode, for testing external controllers:
+ *
+ *     cones --plant [seconds] [--socket] [--with-controller]
+ *
+ * Runs the default simulation in lockstep with a controller attached through
+ * PlantServer, then prints round trip latency and speed. Commands come back
+ * through shared memory unless --socket is given. --with-controller also
+ * starts the stand-in controller in a child process.
+ */
+//-----------------------------------------------------------------------------
+
+static int plantMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+    PlantLink::CommandPath path = args.contains("--socket") ? PlantLink::LocalSocket : PlantLink::SharedMemory;
+
+    Simulator sim(Simulator::defaults(1.0 / FPS));
+    double seconds = option(args, "--plant", "600").toDouble();
+    quint64 steps = (quint64)(seconds / sim.params().timestep + 0.5);
+
+    PlantServer plant(PlantLink::defaultName(), path);
+    if (!plant.open()) {
+        out << "plant: " << plant.errorString() << "\n";
+        return 1;
+    }
+
+    QProcess controller;
+    if (args.contains("--with-controller")) {
+        QStringList cargs("--controller");
+        if (path == PlantLink::LocalSocket)
+            cargs << "--socket";
+        controller.setProcessChannelMode(QProcess::ForwardedChannels);
+        controller.start(a.applicationFilePath(), cargs);
+    }
+
+    bool ok = plant.waitForController(LINK_TIMEOUT) && plant.run(sim, steps, LINK_TIMEOUT);
+    out << plant.report();
+    if (!ok)
+        out << "plant: " << plant.errorString() << "\n";
+
+    controller.waitForFinished(LINK_TIMEOUT);
+    return ok ? 0 : 1;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Stand-in controller mode, the other end of --plant:
+ *
+ *     cones --controller [--socket]
+ */
+//-----------------------------------------------------------------------------
+
+static int controllerMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    PlantLink::CommandPath path = a.arguments().contains("--socket") ? PlantLink::LocalSocket : PlantLink::SharedMemory;
+
+    StandInController controller(PlantLink::defaultName(), path);
+    if (!controller.open(LINK_TIMEOUT)) {
+        out << "controller: " << controller.errorString() << "\n";
+        return 1;
+    }
+
+    out << "controller: answered " << controller.run(LINK_TIMEOUT) << " steps\n";
+    return 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Headless frame export mode:
+ *
+ *     cones --export <dir> [--seconds n] [--size WxH] [--format png]
+ *                          [--frame-skip n]
+ *
+ * Runs the default simulation and writes every frame to dir with
+ * FrameExporter, as fast as the machine allows. Doesn't need a display.
+ */
+//-----------------------------------------------------------------------------
+
+static int exportMain (int argc, char *argv[]) {
+
+    QApplication a(argc, argv, false);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    QString dir = option(args, "--export");
+    if (dir.isEmpty()) {
+        out << "export: no output directory given\n";
+        return 1;
+    }
+
+    QStringList size = option(args, "--size", "785x363").split('x');
+    int frameskip = qMax(1, option(args, "--frame-skip", "1").toInt());
+    double seconds = option(args, "--seconds", "60").toDouble();
+
+    Simulator sim(Simulator::defaults(1.0 / FPS));
+    int frames = (int)(seconds / (frameskip * sim.params().timestep) + 0.5);
+    FrameExporter exporter(dir, QSize(size.value(0).toInt(), size.value(1).toInt()),
+                           option(args, "--format", "png"));
+    exporter.setFrameSkip(frameskip);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = exporter.run(sim, frames);
+    double wall = timer.elapsed() / 1000.0;
+
+    out << "export: " << frames << " frames in " << wall << " s\n";
+    if (!ok)
+        out << "export: " << exporter.errorString() << "\n";
+
+    return ok ? 0 : 1;
+
+}
+
+
+static Scenario::Result runScenario (const Scenario &s) {
+
+    return s.run();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Headless scenario mode, for long runs:
+ *
+ *     cones --scenario <name> [--seconds n] [--replicas n]
+ *                             [--parallel-threshold n]
+ *
+ * Runs a named Scenario (see scenarios.cpp), optionally as several replicas
+ * with consecutive seeds in parallel, and prints totals plus the merged fill
+ * latency and idle gap distributions. --parallel-threshold overrides
+ * Simulator::setParallelThreshold() (0 = single threaded steps).
+ */
+//-----------------------------------------------------------------------------
+
+static int scenarioMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    Scenario s;
+    if (!Scenario::find(option(args, "--scenario"), s)) {
+        out << "scenario: unknown scenario, try one of:";
+        foreach (const Scenario &known, Scenario::all())
+            out << " " << known.name;
+        out << "\n";
+        return 1;
+    }
+
+    s.seconds = option(args, "--seconds", QString::number(s.seconds)).toDouble();
+    s.parallelThreshold = option(args, "--parallel-threshold", QString::number(s.parallelThreshold)).toInt();
+    int replicas = qMax(1, option(args, "--replicas", "1").toInt());
+
+    QList<Scenario> runs;
+    for (int n = 0; n < replicas; ++ n, ++ s.seed)
+        runs << s;
+
+    QList<Scenario::Result> results = QtConcurrent::blockingMapped(runs, runScenario);
+
+    Simulator::Stats total;
+    QuantileSketch latency, gaps;
+    double wall = 0;
+    foreach (const Scenario::Result &r, results) {
+        total.spawned += r.stats.spawned;
+        total.filled += r.stats.filled;
+        total.missed += r.stats.missed;
+        total.blocked += r.stats.blocked;
+        latency.merge(r.fillLatency);
+        gaps.merge(r.idleGaps);
+        wall = qMax(wall, r.wallSeconds);
+    }
+
+    out << "scenario:    " << s.name << " x " << replicas << ", " << s.seconds << " s each\n";
+    out << "cones:       " << total.spawned << " spawned, " << total.filled << " filled, "
+        << total.missed << " missed (fill ratio " << total.fillRatio() << ")\n";
+    if (total.blocked)
+        out << "saturated:   " << total.blocked << " arrivals found no room in the drop area\n";
+    out << "fill time:   " << latency.summary() << "\n";
+    out << "idle gaps:   " << gaps.summary() << "\n";
+    out << "wall time:   " << wall << " s\n";
+
+    return 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Batched environment benchmark:
+ *
+ *     cones --batch-env [envs] [--slots n] [--steps n]
+ *
+ * Steps a BatchEnv with a random policy (pick a random slot, idle if it's
+ * empty) and prints the env-step rate and the mean episode reward.
+ */
+//-----------------------------------------------------------------------------
+
+static int batchEnvMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    int envs = qMax(1, option(args, "--batch-env", "256").toInt());
+    int coneSlots = qMax(1, option(args, "--slots", "8").toInt());
+    int steps = qMax(1, option(args, "--steps", "10000").toInt());
+
+    BatchEnv env(Simulator::defaults(1.0 / FPS), envs, coneSlots);
+    Rng rng(1);
+    double reward = 0;
+    quint64 episodes = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int n = 0; n < steps; ++ n) {
+        qint32 *actions = env.actions();
+        const float *mask = env.coneMask();
+        for (int i = 0; i < envs; ++ i) {
+            int k = (int)(rng.uniform() * coneSlots);
+            actions[i] = (mask[i * coneSlots + k] > 0.0f ? k : -1);
+        }
+        env.step();
+        const float *rewards = env.rewards();
+        const quint8 *dones = env.dones();
+        for (int i = 0; i < envs; ++ i) {
+            reward += rewards[i];
+            episodes += dones[i];
+        }
+    }
+
+    double wall = timer.nsecsElapsed() / 1e9;
+
+    out << "batch-env:   " << envs << " envs x " << steps << " steps in " << wall << " s\n";
+    out << "rate:        " << (quint64)(envs * (double)steps / wall) << " env-steps/s\n";
+    out << "episodes:    " << episodes << " finished, mean reward "
+        << (episodes ? reward / episodes : 0.0) << "\n";
+
+    return 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Capacity estimate mode:
+ *
+ *     cones --capacity [--belt-speed v] [--hose-speed v] [--fill-rate v]
+ *                      [--hose-range w] [--validate [--seconds n]]
+ *
+ * Prints CapacityModel's estimate for the default parameters (with any
+ * overrides). --validate also compares the model with simulator runs over a
+ * parameter grid and prints the error bounds. That is up to
+ * CapacityModel::validateRuns() runs of n seconds (default 600), so use a
+ * smaller n for a quick look.
+ */
+//-----------------------------------------------------------------------------
+
+static int capacityMain (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    Simulator::Parameters p = Simulator::defaults(1.0 / FPS);
+    p.beltSpeed = option(args, "--belt-speed", QString::number(p.beltSpeed)).toDouble();
+    p.hoseSpeed = option(args, "--hose-speed", QString::number(p.hoseSpeed)).toDouble();
+    p.hoseFillRate = option(args, "--fill-rate", QString::number(p.hoseFillRate)).toDouble();
+    p.hoseRange.setWidth(option(args, "--hose-range", QString::number(p.hoseRange.width())).toDouble());
+
+    CapacityModel::Estimate e = CapacityModel::estimate(p);
+    out << "travel:      " << e.travelTime << " s per cone\n";
+    out << "fill:        " << e.fillTime << " s per cone\n";
+    out << "cycle:       " << e.cycleTime << " s (window " << e.window << " s)\n";
+    out << "drop area:   " << e.dropRate << " cones/s\n";
+    out << "max rate:    " << e.maxRate << " cones/s\n";
+
+    if (!args.contains("--validate"))
+        return 0;
+
+    double seconds = option(args, "--seconds", "600").toDouble();
+    out << "\nvalidating: at most " << CapacityModel::validateRuns() << " runs of "
+        << seconds << " s\n";
+    out.flush();
+
+    QList<CapacityModel::Check> checks = CapacityModel::validate(seconds);
+    QVector<double> errors;
+
+    out << "\nbelt  hose  fill  range  predicted  simulated    bracket   error\n";
+    foreach (const CapacityModel::Check &c, checks) {
+        out << qSetFieldWidth(4) << c.params.beltSpeed << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(4) << c.params.hoseSpeed << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(4) << c.params.hoseFillRate << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(5) << c.params.hoseRange.width() << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(9) << c.predicted << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(9) << c.simulated << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(9) << c.bracket << qSetFieldWidth(0) << "  "
+            << qSetFieldWidth(6) << c.error() * 100.0 << qSetFieldWidth(0) << "%\n";
+        errors << qAbs(c.error());
+    }
+
+    qSort(errors);
+    double mean = 0;
+    foreach (double err, errors)
+        mean += err;
+    mean /= qMax(1, errors.size());
+
+    out << "\n|error|:     mean " << mean * 100.0 << "%, p90 "
+        << errors.value((int)(0.9 * (errors.size() - 1))) * 100.0 << "%, max "
+        << (errors.isEmpty() ? 0.0 : errors.back()) * 100.0 << "%\n";
+
+    return 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Picks the mode from the command line and runs it.
+ */
+//-----------------------------------------------------------------------------
+
+static int run (int argc, char *argv[]) {
+
+    for (int n = 1; n < argc; ++ n) {
+        if (!strcmp(argv[n], "--control-loop"))
+            return controlLoopMain(argc, argv);
+        else if (!strcmp(argv[n], "--plant"))
+            return plantMain(argc, argv);
+        else if (!strcmp(argv[n], "--controller"))
+            return controllerMain(argc, argv);
+        else if (!strcmp(argv[n], "--export"))
+            return exportMain(argc, argv);
+        else if (!strcmp(argv[n], "--scenario"))
+            return scenarioMain(argc, argv);
+        else if (!strcmp(argv[n], "--batch-env"))
+            return batchEnvMain(argc, argv);
+        else if (!strcmp(argv[n], "--capacity"))
+            return capacityMain(argc, argv);
+    }
 
     QApplication a(argc, argv);
     MainWindow w;
@@ -39,3 +490,30 @@ int main (int argc, char *argv[]) {
     return a.exec();
 
 }
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Any mode can be profiled with --trace <file>, which writes Chrome trace
+ * event JSON (see tracelog.h) for the whole run.
+ */
+//-----------------------------------------------------------------------------
+
+int main (int argc, char *argv[]) {
+
+    const char *trace = NULL;
+    for (int n = 1; n + 1 < argc; ++ n)
+        if (!strcmp(argv[n], "--trace"))
+            trace = argv[n + 1];
+
+    if (trace && !TraceLog::start(QString::fromLocal8Bit(trace))) {
+        fprintf(stderr, "trace: could not open %s\n", trace);
+        return 1;
+    }
+
+    int result = run(argc, argv);
+    TraceLog::stop();
+
+    return result;
+
+}
@@ -29,30 +29,28 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QTimer>
+#include <QDoubleSpinBox>
+#include <QFileDialog>
+#include <QMessageBox>
+#include "tracelog.h"
+
+#define BURSTY_ON   6.0     /**< Mean burst length for bursty arrivals (seconds). */
+#define BURSTY_OFF  4.0     /**< Mean gap length for bursty arrivals (seconds). */
+#define FORECAST_DELAY 250  /**< Forecast this long (ms) after the last parameter change. */
 
 
 MainWindow::MainWindow (QWidget *parent) :
     QMainWindow(parent),
     ui_(new Ui::MainWindow),
-    frameskip_(1)
+    frameskip_(1),
+    arrivals_(0),
+    hoseAccel_(0)
 {
 
     ui_->setupUi(this);
+    title_ = windowTitle();
 
-#define FPS 50
-
-    Simulator::Parameters p;
-    p.timestep = 1.0 / FPS;
-    p.beltWidth = 24.0;
-    p.beltSpeed = 2.0;
-    p.coneRate = 1.7;
-    p.coneDrop = QRectF(-36, 0, 24, p.beltWidth).adjusted(0, 2, 0, -2);
-    p.hoseRange = QRectF(12, 0, 36, p.beltWidth).adjusted(0, 1, 0, -1);
-    p.hoseFillRate = 3.0;
-    p.hoseSpeed = 20.0;
-    p.urgentTime = 3.0;
-
-    sim_ = new Simulator(p, this);
+    sim_ = new Simulator(Simulator::defaults(1.0 / FPS), this);
     ui_->view->setSimulator(sim_);
 #if !AUTO_BOUNDS
     ui_->view->setViewBounds(-36, 72);
@@ -67,8 +65,22 @@ MainWindow::MainWindow (QWidget *parent) :
     connect(ui_->sbFillRate, SIGNAL(valueChanged(double)), sim_, SLOT(setFillRate(double)));
     connect(ui_->sbUrgentTime, SIGNAL(valueChanged(double)), sim_, SLOT(setUrgentTime(double)));
 
+    forecast_ = new Forecast(this);
+    forecastDelay_ = new QTimer(this);
+    forecastDelay_->setSingleShot(true);
+    forecastDelay_->setInterval(FORECAST_DELAY);
+    connect(forecastDelay_, SIGNAL(timeout()), SLOT(startForecast()));
+    connect(forecast_, SIGNAL(finished(Forecast::Result)), SLOT(showForecast(Forecast::Result)));
+
+    QList<QDoubleSpinBox *> options;
+    options << ui_->sbBeltSpeed << ui_->sbBeltWidth << ui_->sbConeRate << ui_->sbConeVariance
+            << ui_->sbHoseWidth << ui_->sbHoseSpeed << ui_->sbFillRate << ui_->sbUrgentTime;
+    foreach (QDoubleSpinBox *option, options)
+        connect(option, SIGNAL(valueChanged(double)), SLOT(scheduleForecast()));
+
     startTimer(1000 / FPS);
     showOptions();
+    scheduleForecast();
 
 }
 
@@ -82,9 +94,15 @@ MainWindow::~MainWindow () {
 
 void MainWindow::timerEvent (QTimerEvent *) {
 
+    TRACE_SPAN("MainWindow::timerEvent");
+
     for (int n = 0; n < frameskip_; ++ n)
         sim_->update();
 
+    QString title = sim_->saturated() ? title_ + " - drop area saturated" : title_;
+    if (title != windowTitle())
+        setWindowTitle(title);
+
     ui_->view->update();
 
 }
@@ -101,5 +119,88 @@ void MainWindow::showOptions () {
     ui_->sbHoseSpeed->setValue(sim_->params().hoseSpeed);
     ui_->sbFillRate->setValue(sim_->params().hoseFillRate);
     ui_->sbUrgentTime->setValue(sim_->params().urgentTime);
+    ui_->cbArrivals->setCurrentIndex(arrivals_);
+    ui_->sbHoseAccel->setValue(hoseAccel_);
+
+}
+
+
+void MainWindow::on_cbArrivals_activated (int index) {
+
+    ArrivalModel *model = NULL;
+
+    switch (index) {
+    case 0: model = new RegularArrivals(); break;
+    case 1: model = new PoissonArrivals(); break;
+    case 2: model = new BurstyArrivals(BURSTY_ON, BURSTY_OFF); break;
+    case 3: {
+        QString filename = QFileDialog::getOpenFileName(this, "Replay Arrival Trace");
+        if (filename.isEmpty())
+            break;
+        TraceArrivals *trace = new TraceArrivals(filename);
+        if (!trace->isOpen()) {
+            QMessageBox::critical(this, "Arrival Trace", trace->errorString());
+            delete trace;
+            break;
+        }
+        model = trace;
+        break;
+    }
+    }
+
+    if (model) {
+        sim_->setArrivalModel(model);
+        arrivals_ = index;
+        scheduleForecast();
+    } else {
+        ui_->cbArrivals->setCurrentIndex(arrivals_);
+    }
+
+}
+
+
+void MainWindow::on_sbHoseAccel_valueChanged (double v) {
+
+    if (v <= 0.0) {
+        sim_->setHoseDrive(new ConstantSpeedDrive(sim_->params().hoseSpeed));
+    } else {
+        AxisLimitedDrive::Limits limits;
+        limits.maxSpeed = QVector2D(sim_->params().hoseSpeed, sim_->params().hoseSpeed);
+        limits.maxAccel = QVector2D(v, v);
+        sim_->setHoseDrive(new AxisLimitedDrive(limits));
+    }
+
+    hoseAccel_ = v;
+    scheduleForecast();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Parameter changed: forecast from the new state once changes settle down.
+ * Any forecast already running is out of date, so it's cancelled now.
+ */
+//-----------------------------------------------------------------------------
+
+void MainWindow::scheduleForecast () {
+
+    forecast_->cancel();
+    forecastDelay_->start();
+    ui_->lblForecast->setText("Forecasting...");
+
+}
+
+
+void MainWindow::startForecast () {
+
+    forecast_->start(*sim_);
+
+}
+
+
+void MainWindow::showForecast (const Forecast::Result &result) {
+
+    ui_->lblForecast->setText(result.toString());
 
 }
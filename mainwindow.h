@@ -31,11 +31,16 @@
 
 #include <QMainWindow>
 #include "simulator.h"
+#include "forecast.h"
+
+#define FPS 50 /**< Simulation / display rate. */
 
 namespace Ui {
 class MainWindow;
 }
 
+class QTimer;
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
     
@@ -51,12 +56,22 @@ protected:
 private slots:
 
     void on_sbFrameSkip_valueChanged (int v) { frameskip_ = v; }
+    void on_cbArrivals_activated (int index);
+    void on_sbHoseAccel_valueChanged (double v);
+    void scheduleForecast ();
+    void startForecast ();
+    void showForecast (const Forecast::Result &result);
 
 private:
 
     Ui::MainWindow *ui_;
     Simulator *sim_;
     int frameskip_;
+    int arrivals_;          /**< Index of current cbArrivals selection. */
+    double hoseAccel_;      /**< Hose axis acceleration limit, 0 = instant. */
+    QString title_;         /**< Window title, without status. */
+    Forecast *forecast_;    /**< Look-ahead after parameter changes. */
+    QTimer *forecastDelay_; /**< Waits for parameter changes to settle. */
 
     void showOptions ();
 
@@ -0,0 +1,566 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "plantlink.h"
+#include "latencystats.h"
+#include <cstring>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QTextStream>
+
+using namespace PlantLink;
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Ordered (full barrier) read of an atomic that may live in shared memory.
+ */
+//-----------------------------------------------------------------------------
+
+static int load (const QAtomicInt &a) {
+
+    return const_cast<QAtomicInt &>(a).fetchAndAddOrdered(0);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  x rounded up to a multiple of 64 (cache line).
+ */
+//-----------------------------------------------------------------------------
+
+static int align64 (int x) {
+
+    return (x + 63) & ~63;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  Default shared memory key / socket name.
+ */
+//-----------------------------------------------------------------------------
+
+QString PlantLink::defaultName () {
+
+    return "cones-plant";
+
+}
+
+
+//=============================================================================
+// PlantServer
+//=============================================================================
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Call open() next.
+ *
+ * @param   name        Shared memory key, and socket name for LocalSocket.
+ * @param   path        How commands come back.
+ * @param   maxCones    Max cones published per step; more are truncated.
+ * @param   ring        Number of state slots.
+ */
+//-----------------------------------------------------------------------------
+
+PlantServer::PlantServer (const QString &name, CommandPath path, int maxCones,
+                          int ring, QObject *parent) :
+    QObject(parent),
+    name_(name),
+    path_(path),
+    maxCones_(maxCones),
+    ring_(ring),
+    shm_(name),
+    server_(NULL),
+    socket_(NULL)
+{
+}
+
+
+PlantServer::~PlantServer () {
+
+    close();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Create and initialize the shared memory, and start listening if commands
+ * come over a socket. Leftovers from a crashed plant are cleaned up first.
+ *
+ * @return  True on success, otherwise see errorString().
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantServer::open () {
+
+    int slotSize = align64(sizeof(State) + maxCones_ * sizeof(PlantLink::Cone));
+    int size = align64(sizeof(Header)) + ring_ * slotSize;
+
+    // on unix a crashed owner leaves the segment behind; attaching and
+    // detaching again gets rid of it
+    if (shm_.attach())
+        shm_.detach();
+
+    if (!shm_.create(size)) {
+        error_ = shm_.errorString();
+        return false;
+    }
+
+    memset(shm_.data(), 0, size);
+    Header *h = header();
+    h->magic = Magic;
+    h->version = Version;
+    h->ring = ring_;
+    h->maxCones = maxCones_;
+    h->slotSize = slotSize;
+    h->command.command.step = NoStep;
+    h->latest.fetchAndStoreOrdered(-1);
+
+    if (path_ == LocalSocket) {
+        QLocalServer::removeServer(name_);
+        server_ = new QLocalServer(this);
+        if (!server_->listen(name_)) {
+            error_ = server_->errorString();
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Wait for the controller to connect. Only needed for LocalSocket; the shared
+ * memory path just waits for commands.
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantServer::waitForController (int msecs) {
+
+    if (path_ != LocalSocket || socket_)
+        return true;
+
+    if (!server_->waitForNewConnection(msecs) || !(socket_ = server_->nextPendingConnection())) {
+        error_ = "controller did not connect";
+        return false;
+    }
+
+    return true;
+
+}
+
+
+PlantLink::State * PlantServer::slot (int index) {
+
+    return reinterpret_cast<State *>(static_cast<char *>(shm_.data())
+            + align64(sizeof(Header)) + index * header()->slotSize);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Write the simulator's current state into the next ring slot and make it the
+ * latest one.
+ */
+//-----------------------------------------------------------------------------
+
+void PlantServer::publish (const Simulator &sim, quint64 step) {
+
+    int index = (int)(step % ring_);
+    State *s = slot(index);
+    const Simulator::Parameters &p = sim.params();
+    const QList<Simulator::Cone *> &cones = sim.cones();
+
+    s->seq.fetchAndAddOrdered(1);
+
+    int count = qMin(cones.size(), maxCones_);
+    s->count = count;
+    s->truncated = (cones.size() > maxCones_);
+    s->hoseState = sim.hose().state;
+    s->step = step;
+    s->t = sim.time();
+    s->hoseX = sim.hose().pos.x();
+    s->hoseY = sim.hose().pos.y();
+    s->beltSpeed = p.beltSpeed;
+    s->hoseRange = p.hoseRange;
+    s->hoseFillRate = p.hoseFillRate;
+
+    PlantLink::Cone *out = s->cones();
+    for (int n = 0; n < count; ++ n, ++ out) {
+        out->x = cones[n]->pos.x();
+        out->y = cones[n]->pos.y();
+        out->fill = cones[n]->fill;
+        out->id = cones[n]->id;
+    }
+
+    s->seq.fetchAndAddOrdered(1);
+    header()->latest.fetchAndStoreOrdered(index);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Wait for the command answering step. Spins (yielding) on the shared command
+ * slot, or blocks on the socket. Commands for earlier steps are skipped.
+ *
+ * @return  False on timeout or disconnect.
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantServer::waitForCommand (quint64 step, Simulator::HoseCommand &c, int msecs) {
+
+    QElapsedTimer timer;
+    Command cmd;
+    timer.start();
+
+    if (path_ == SharedMemory) {
+
+        CommandSlot &cs = header()->command;
+        for (;;) {
+            int seq = load(cs.seq);
+            if (!(seq & 1)) {
+                cmd = cs.command;
+                if (load(cs.seq) == seq && cmd.step == step)
+                    break;
+            }
+            if (timer.elapsed() > msecs) {
+                error_ = "timed out waiting for command";
+                return false;
+            }
+            QThread::yieldCurrentThread();
+        }
+
+    } else {
+
+        for (;;) {
+            while (socket_->bytesAvailable() < (qint64)sizeof(cmd)) {
+                int left = msecs - (int)timer.elapsed();
+                if (left <= 0 || !socket_->waitForReadyRead(left)) {
+                    error_ = "timed out waiting for command";
+                    return false;
+                }
+            }
+            socket_->read(reinterpret_cast<char *>(&cmd), sizeof(cmd));
+            if (cmd.step == step)
+                break;
+        }
+
+    }
+
+    c.hasTarget = (cmd.hasTarget != 0);
+    c.targetId = cmd.targetId;
+    c.dest = QVector2D(cmd.destX, cmd.destY);
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Tell the controller we're done and tear everything down.
+ */
+//-----------------------------------------------------------------------------
+
+void PlantServer::close () {
+
+    if (shm_.isAttached()) {
+        header()->closed.fetchAndStoreOrdered(1);
+        shm_.detach();
+    }
+
+    delete socket_;
+    socket_ = NULL;
+    delete server_;
+    server_ = NULL;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Run sim in lockstep with the controller for the given number of steps, as
+ * fast as the controller answers. Puts sim under external control. Fills in
+ * report() with round trip latency and speed.
+ *
+ * @return  False if the controller stopped answering (see errorString()).
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantServer::run (Simulator &sim, quint64 steps, int timeoutMsecs) {
+
+    LatencySamples rtt((int)qMin(steps, (quint64)1000000));
+    QElapsedTimer clock;
+    Simulator::HoseCommand c;
+    quint64 step;
+    bool ok = true;
+
+    sim.setExternalControl(true);
+    clock.start();
+
+    for (step = 0; step < steps; ++ step) {
+        qint64 start = clock.nsecsElapsed();
+        publish(sim, step);
+        if (!waitForCommand(step, c, timeoutMsecs)) {
+            ok = false;
+            break;
+        }
+        rtt.add(clock.nsecsElapsed() - start);
+        sim.command(c);
+        sim.update();
+    }
+
+    double wall = clock.nsecsElapsed() / 1e9;
+    close();
+
+    QTextStream out(&report_);
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(1);
+    out << "steps:      " << step << "\n";
+    out << "round trip: " << rtt.summary() << "\n";
+    out << "speed:      " << (wall > 0 ? step / wall : 0.0) << " steps/s, "
+        << (wall > 0 ? sim.time() / wall : 0.0) << "x real time\n";
+
+    return ok;
+
+}
+
+
+//=============================================================================
+// PlantClient
+//=============================================================================
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Call open() next.
+ *
+ * @param   name    Shared memory key, and socket name for LocalSocket.
+ * @param   path    How commands are sent.
+ */
+//-----------------------------------------------------------------------------
+
+PlantClient::PlantClient (const QString &name, CommandPath path, QObject *parent) :
+    QObject(parent),
+    name_(name),
+    path_(path),
+    shm_(name),
+    socket_(NULL)
+{
+}
+
+
+PlantClient::~PlantClient () {
+
+    if (shm_.isAttached())
+        shm_.detach();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Attach to the plant, retrying until it shows up or msecs pass.
+ *
+ * @return  True on success, otherwise see errorString().
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantClient::open (int msecs) {
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!shm_.attach()) {
+        if (timer.elapsed() > msecs) {
+            error_ = shm_.errorString();
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+    if (header()->magic != Magic || header()->version != Version) {
+        error_ = "plant shared memory layout mismatch";
+        shm_.detach();
+        return false;
+    }
+
+    if (path_ == LocalSocket) {
+        socket_ = new QLocalSocket(this);
+        socket_->connectToServer(name_);
+        if (!socket_->waitForConnected(qMax(1, msecs - (int)timer.elapsed()))) {
+            error_ = socket_->errorString();
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+
+const PlantLink::State * PlantClient::slot (int index) const {
+
+    return reinterpret_cast<const State *>(static_cast<const char *>(shm_.constData())
+            + align64(sizeof(Header)) + index * header()->slotSize);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Start reading the newest state in place. Returns NULL if nothing has been
+ * published yet. See the class docs for the read loop.
+ *
+ * @param   seq     Receives the sequence to pass to endRead().
+ */
+//-----------------------------------------------------------------------------
+
+const PlantLink::State * PlantClient::beginRead (int &seq) const {
+
+    int index = load(header()->latest);
+    if (index < 0 || index >= (int)header()->ring)
+        return NULL;
+
+    const State *s = slot(index);
+    while ((seq = load(s->seq)) & 1)
+        QThread::yieldCurrentThread();
+
+    return s;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  True if state wasn't modified since beginRead(), i.e. what was read
+ *          is consistent. NULL state (nothing published) counts as consistent.
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantClient::endRead (const PlantLink::State *state, int seq) const {
+
+    return !state || load(state->seq) == seq;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  state->count clamped to the slot size; safe to use before the read
+ *          is validated.
+ */
+//-----------------------------------------------------------------------------
+
+int PlantClient::coneCount (const PlantLink::State *state) const {
+
+    return (int)qMin(state->count, header()->maxCones);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Wait until a state newer than step 'after' is published (pass NoStep for
+ * the first one), or the plant closes.
+ *
+ * @return  False on timeout or if the plant closed.
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantClient::waitForState (quint64 after, int msecs) {
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (;;) {
+        if (closed())
+            return false;
+        int seq;
+        const State *s;
+        quint64 step;
+        do {
+            s = beginRead(seq);
+            step = s ? s->step : NoStep;
+        } while (!endRead(s, seq));
+        if (step != NoStep && (after == NoStep || step > after))
+            return true;
+        if (timer.elapsed() > msecs) {
+            error_ = "timed out waiting for plant";
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+}
+
+
+bool PlantClient::closed () const {
+
+    return load(header()->closed) != 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Send a command to the plant.
+ *
+ * @return  False if the socket write failed.
+ */
+//-----------------------------------------------------------------------------
+
+bool PlantClient::send (const PlantLink::Command &c) {
+
+    if (path_ == SharedMemory) {
+        CommandSlot &cs = mutableHeader()->command;
+        cs.seq.fetchAndAddOrdered(1);
+        cs.command = c;
+        cs.seq.fetchAndAddOrdered(1);
+        return true;
+    }
+
+    if (socket_->write(reinterpret_cast<const char *>(&c), sizeof(c)) != (qint64)sizeof(c)) {
+        error_ = socket_->errorString();
+        return false;
+    }
+    socket_->flush();
+    return true;
+
+}
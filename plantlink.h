@@ -0,0 +1,237 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef PLANTLINK_H
+#define PLANTLINK_H
+
+#include <QObject>
+#include <QSharedMemory>
+#include <QAtomicInt>
+#include <QString>
+#include "simulator.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Shared memory layout for the plant <-> controller link. The plant (the
+ * Simulator, via PlantServer) publishes each step's state into a ring of
+ * PlantState slots; the controller (PlantClient) reads the newest one in
+ * place and answers with a PlantCommand, either in the shared command slot or
+ * over a local socket.
+ *
+ * Every slot is protected by a seqlock: the writer makes seq odd, writes,
+ * then makes it even again, and a reader retries if seq was odd or changed
+ * while it was reading. Nobody ever blocks the writer. The ring gives a slow
+ * reader a few steps before its slot gets reused under it.
+ *
+ * All of this is only meant to be shared between builds of the same binary
+ * on the same machine; there is no attempt at portability of the layout.
+ */
+//-----------------------------------------------------------------------------
+
+namespace PlantLink {
+
+    enum {
+        Magic = 0x434f4e45,     /**< "CONE" */
+        Version = 1,
+        DefaultRing = 4,        /**< Default number of state slots. */
+        DefaultMaxCones = 1024  /**< Default cones per state slot. */
+    };
+
+    /** Command::step before the first command, and "no step" in general. */
+    const quint64 NoStep = Q_UINT64_C(0xffffffffffffffff);
+
+    /** How commands get back to the plant. */
+    enum CommandPath { SharedMemory, LocalSocket };
+
+    /** One cone, as published. */
+    struct Cone {
+        double x;
+        double y;
+        double fill;
+        quint32 id;
+        quint32 reserved;
+    };
+
+    /** One step's state. Followed in memory by Header::maxCones Cones. */
+    struct State {
+        QAtomicInt seq;         /**< Seqlock sequence. */
+        quint32 count;          /**< Number of cones that follow. */
+        quint32 truncated;      /**< Non-zero if there were more than maxCones. */
+        quint32 hoseState;      /**< Simulator::Hose::State. */
+        quint64 step;           /**< Step number. */
+        double t;               /**< Simulation time. */
+        double hoseX;
+        double hoseY;
+        double beltSpeed;
+        QRectF hoseRange;       /**< Hose movement range. */
+        double hoseFillRate;
+        /** @return The cones. */
+        const Cone * cones () const { return reinterpret_cast<const Cone *>(this + 1); }
+        Cone * cones () { return reinterpret_cast<Cone *>(this + 1); }
+    };
+
+    /** A command. hasTarget, targetId and dest are as in Simulator::HoseCommand. */
+    struct Command {
+        quint64 step;           /**< Step this answers. */
+        quint32 hasTarget;
+        quint32 targetId;
+        double destX;
+        double destY;
+    };
+
+    /** Command slot in shared memory. */
+    struct CommandSlot {
+        QAtomicInt seq;         /**< Seqlock sequence. */
+        Command command;
+    };
+
+    /** Start of the shared memory block. */
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 ring;           /**< Number of state slots. */
+        quint32 maxCones;       /**< Cones per state slot. */
+        quint32 slotSize;       /**< Bytes per state slot. */
+        QAtomicInt latest;      /**< Index of newest state slot, -1 = none yet. */
+        QAtomicInt closed;      /**< Non-zero once the plant has finished. */
+        CommandSlot command;    /**< Controller -> plant command. */
+    };
+
+    QString defaultName ();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Plant side of the link. Creates the shared memory (and local server, if
+ * commands come over a socket), publishes Simulator state and collects
+ * commands. run() drives a simulator in lockstep with a controller: publish
+ * step n, wait for the command answering step n, apply it, update. The time
+ * from publish to command is the round trip latency.
+ */
+//-----------------------------------------------------------------------------
+
+class PlantServer : public QObject {
+    Q_OBJECT
+
+public:
+
+    PlantServer (const QString &name, PlantLink::CommandPath path,
+                 int maxCones = PlantLink::DefaultMaxCones,
+                 int ring = PlantLink::DefaultRing, QObject *parent = 0);
+    ~PlantServer ();
+
+    bool open ();
+    bool waitForController (int msecs);
+    QString errorString () const { return error_; }
+
+    void publish (const Simulator &sim, quint64 step);
+    bool waitForCommand (quint64 step, Simulator::HoseCommand &c, int msecs);
+    void close ();
+
+    bool run (Simulator &sim, quint64 steps, int timeoutMsecs);
+    /** @return Report from the last run(). */
+    QString report () const { return report_; }
+
+private:
+
+    QString name_;                  /**< Shared memory key / socket name. */
+    PlantLink::CommandPath path_;   /**< Command path. */
+    int maxCones_;                  /**< Cones per slot. */
+    int ring_;                      /**< Slots in ring. */
+    QSharedMemory shm_;             /**< The shared block. */
+    QLocalServer *server_;          /**< Listens for controller (LocalSocket). */
+    QLocalSocket *socket_;          /**< Connected controller (LocalSocket). */
+    QString error_;                 /**< Last error. */
+    QString report_;                /**< Last run() report. */
+
+    PlantLink::Header * header () { return static_cast<PlantLink::Header *>(shm_.data()); }
+    PlantLink::State * slot (int index);
+
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Controller side of the link. State is read in place, without copying:
+ *
+ *     int seq;
+ *     const PlantLink::State *s;
+ *     do {
+ *         s = client.beginRead(seq);
+ *         ... look at s, s->cones() ...
+ *     } while (!client.endRead(s, seq));
+ *
+ * Anything read between beginRead() and a successful endRead() may be torn
+ * and must only be trusted after endRead() returns true (counts are clamped
+ * so indexing is always safe though).
+ */
+//-----------------------------------------------------------------------------
+
+class PlantClient : public QObject {
+    Q_OBJECT
+
+public:
+
+    PlantClient (const QString &name, PlantLink::CommandPath path, QObject *parent = 0);
+    ~PlantClient ();
+
+    bool open (int msecs);
+    QString errorString () const { return error_; }
+
+    bool waitForState (quint64 after, int msecs);
+    bool closed () const;
+
+    const PlantLink::State * beginRead (int &seq) const;
+    bool endRead (const PlantLink::State *state, int seq) const;
+    int coneCount (const PlantLink::State *state) const;
+
+    bool send (const PlantLink::Command &c);
+
+private:
+
+    QString name_;                  /**< Shared memory key / socket name. */
+    PlantLink::CommandPath path_;   /**< Command path. */
+    QSharedMemory shm_;             /**< The shared block. */
+    QLocalSocket *socket_;          /**< Connection to plant (LocalSocket). */
+    QString error_;                 /**< Last error. */
+
+    const PlantLink::Header * header () const { return static_cast<const PlantLink::Header *>(shm_.constData()); }
+    const PlantLink::State * slot (int index) const;
+    PlantLink::Header * mutableHeader () { return static_cast<PlantLink::Header *>(shm_.data()); }
+
+};
+
+
+#endif // PLANTLINK_H
@@ -0,0 +1,395 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QProcess>
+#include <QFile>
+#include <QMap>
+#include <QElapsedTimer>
+#include <cstdio>
+#include "scenarios.h"
+#include "batchenv.h"
+
+#if defined(Q_OS_WIN)
+#  include <windows.h>
+#  include <psapi.h>
+#endif
+
+#define FILL_TOLERANCE      0.005   /**< Allowed absolute drop in fill ratio. */
+#define MISSED_TOLERANCE    0.02    /**< Allowed relative growth in missed cones. */
+#define SPEED_TOLERANCE     0.15    /**< Allowed relative drop in steps/second. */
+#define MEMORY_TOLERANCE    0.25    /**< Relative peak memory growth that gets a warning. */
+
+#define BATCH_NAME          "batch-env" /**< Name of the BatchEnv benchmark entry. */
+#define BATCH_ENVS          256     /**< Envs in the BatchEnv benchmark. */
+#define BATCH_SLOTS         8       /**< Cone slots per env. */
+#define BATCH_STEPS         15000   /**< BatchEnv::step() calls. */
+#define BATCH_EPISODE       60.0    /**< Episode length (seconds), so envs reset during the run. */
+#define BATCH_TIMESTEP      (1.0 / 50) /**< Timestep (matches the scenarios). */
+
+
+//-----------------------------------------------------------------------------
+/**
+ * One scenario's measurements, as printed by --run. Fill ratio and missed
+ * count depend only on the code (scenarios are seeded), so they're checked
+ * against baseline.txt, which is committed. Speed and memory depend on the
+ * machine, so they're checked against a separate file that each machine
+ * records for itself with --update-baseline.
+ */
+//-----------------------------------------------------------------------------
+
+struct Metrics {
+    double fillRatio;
+    quint64 missed;
+    double stepsPerSecond;
+    quint64 peakMemoryKB;
+    Metrics () : fillRatio(0), missed(0), stepsPerSecond(0), peakMemoryKB(0) { }
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  Peak resident memory of this process in KB, or 0 if unknown on
+ *          this platform.
+ */
+//-----------------------------------------------------------------------------
+
+static quint64 peakMemoryKB () {
+
+#if defined(Q_OS_LINUX)
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&status);
+        QString line;
+        while (!(line = in.readLine()).isNull())
+            if (line.startsWith("VmHWM:"))
+                return line.section(' ', 1, -1, QString::SectionSkipEmpty).section(' ', 0, 0).toULongLong();
+    }
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / 1024;
+#endif
+
+    return 0;
+
+}
+
+
+static QString format (const QString &name, const Metrics &m) {
+
+    return QString("%1 %2 %3 %4 %5").arg(name).arg(m.fillRatio, 0, 'f', 6).arg(m.missed)
+            .arg(m.stepsPerSecond, 0, 'f', 1).arg(m.peakMemoryKB);
+
+}
+
+
+static QString formatResults (const QString &name, const Metrics &m) {
+
+    return QString("%1 %2 %3").arg(name).arg(m.fillRatio, 0, 'f', 6).arg(m.missed);
+
+}
+
+
+static QString formatSpeed (const QString &name, const Metrics &m) {
+
+    return QString("%1 %2 %3").arg(name).arg(m.stepsPerSecond, 0, 'f', 1).arg(m.peakMemoryKB);
+
+}
+
+
+static bool parse (const QString &line, QString &name, Metrics &m) {
+
+    QStringList f = line.split(' ', QString::SkipEmptyParts);
+    if (f.size() != 5)
+        return false;
+
+    name = f[0];
+    m.fillRatio = f[1].toDouble();
+    m.missed = f[2].toULongLong();
+    m.stepsPerSecond = f[3].toDouble();
+    m.peakMemoryKB = f[4].toULongLong();
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Throughput of BatchEnv, the policy training interface: BATCH_ENVS envs
+ * stepped BATCH_STEPS times with a policy that always fills the first
+ * observed cone. Episodes are short enough that every env resets several
+ * times.
+ *
+ * @return  Env steps (envs times step() calls) per second.
+ */
+//-----------------------------------------------------------------------------
+
+static double batchEnvStepsPerSecond () {
+
+    BatchEnv env(Simulator::defaults(BATCH_TIMESTEP), BATCH_ENVS, BATCH_SLOTS);
+    env.setEpisodeSeconds(BATCH_EPISODE);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int n = 0; n < BATCH_STEPS; ++ n) {
+        // slot 0 is empty if no cone is in range, which means go idle
+        for (int i = 0; i < env.envs(); ++ i)
+            env.actions()[i] = 0;
+        env.step();
+    }
+
+    qint64 ns = timer.nsecsElapsed();
+    return ns > 0 ? (double)BATCH_ENVS * BATCH_STEPS * 1e9 / ns : 0.0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * --run mode: run one scenario in this process and print its metrics line.
+ * Each scenario gets its own process so peak memory is its own. BATCH_NAME
+ * runs the BatchEnv benchmark instead, which only has a speed (env steps
+ * per second) and peak memory.
+ */
+//-----------------------------------------------------------------------------
+
+static int runOne (const QString &name) {
+
+    Metrics m;
+
+    if (name == BATCH_NAME) {
+        m.stepsPerSecond = batchEnvStepsPerSecond();
+    } else {
+        Scenario s;
+        if (!Scenario::find(name, s)) {
+            fprintf(stderr, "unknown scenario %s\n", qPrintable(name));
+            return 2;
+        }
+        Scenario::Result r = s.run();
+        m.fillRatio = r.stats.fillRatio();
+        m.missed = r.stats.missed;
+        m.stepsPerSecond = r.stepsPerSecond();
+    }
+
+    m.peakMemoryKB = peakMemoryKB();
+
+    printf("%s\n", qPrintable(format(name, m)));
+    return 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Read a baseline file: one line per scenario, the name followed by fields
+ * values. Lines starting with # are comments.
+ *
+ * @return  Fields (not including the name) by scenario name. Empty if the
+ *          file couldn't be read.
+ */
+//-----------------------------------------------------------------------------
+
+static QMap<QString, QStringList> readTable (const QString &filename, int fields) {
+
+    QMap<QString, QStringList> table;
+    QFile file(filename);
+
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&file);
+        QString line;
+        while (!(line = in.readLine()).isNull()) {
+            QStringList f = line.split(' ', QString::SkipEmptyParts);
+            if (!line.startsWith('#') && f.size() == fields + 1) {
+                QString name = f.takeFirst();
+                table[name] = f;
+            }
+        }
+    }
+
+    return table;
+
+}
+
+
+static bool writeTable (const QString &filename, const QString &header, const QStringList &lines) {
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+    out << header << "\n";
+    foreach (const QString &line, lines)
+        out << line << "\n";
+
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Run every scenario, then the BatchEnv benchmark, in a child process each
+ * and compare with the baselines. The benchmark is only checked against
+ * the speed baseline. Exit code 1 if anything regressed.
+ *
+ * @param   self            This executable, for the children.
+ * @param   baselineFile    Fill ratio / missed baseline (committed).
+ * @param   speedFile       Steps/s / peak memory baseline (per machine).
+ * @param   update          Rewrite speedFile instead of checking speed.
+ * @param   updateResults   Rewrite baselineFile instead of checking results;
+ *                          for changes that are meant to alter them.
+ */
+//-----------------------------------------------------------------------------
+
+static int runAll (const QString &self, const QString &baselineFile, const QString &speedFile,
+                   bool update, bool updateResults) {
+
+    QTextStream out(stdout);
+    QMap<QString, QStringList> results, speeds;
+    QString name;
+    Metrics m;
+
+    if (!updateResults) {
+        results = readTable(baselineFile, 2);
+        if (results.isEmpty())
+            out << "no baseline in " << baselineFile << ", not checking results\n";
+    }
+
+    if (!update) {
+        speeds = readTable(speedFile, 2);
+        if (speeds.isEmpty())
+            out << "no speed baseline in " << speedFile << ", not checking speed"
+                << " (record one with --update-baseline)\n";
+    }
+
+    QStringList entries, resultLines, speedLines;
+    int failures = 0;
+
+    foreach (const Scenario &s, Scenario::all())
+        entries << s.name;
+    entries << BATCH_NAME;
+
+    foreach (const QString &entry, entries) {
+
+        bool speedOnly = (entry == BATCH_NAME);
+
+        QProcess child;
+        child.start(self, QStringList() << "--run" << entry);
+        if (!child.waitForFinished(-1) || child.exitCode() != 0 ||
+            !parse(QString::fromAscii(child.readAllStandardOutput()).trimmed(), name, m)) {
+            out << entry << ": FAILED TO RUN\n";
+            ++ failures;
+            continue;
+        }
+
+        if (!speedOnly)
+            resultLines << formatResults(entry, m);
+        speedLines << formatSpeed(entry, m);
+        out << qSetFieldWidth(10) << left << entry << qSetFieldWidth(0);
+        if (!speedOnly)
+            out << "  fill " << m.fillRatio << "  missed " << m.missed;
+        out << "  steps/s " << m.stepsPerSecond << "  peak " << m.peakMemoryKB << " KB";
+
+        QStringList problems;
+
+        if (!speedOnly && results.contains(entry)) {
+            double fillRatio = results[entry][0].toDouble();
+            quint64 missed = results[entry][1].toULongLong();
+            if (m.fillRatio < fillRatio - FILL_TOLERANCE)
+                problems << QString("fill ratio %1 -> %2").arg(fillRatio).arg(m.fillRatio);
+            if (m.missed > missed * (1.0 + MISSED_TOLERANCE))
+                problems << QString("missed %1 -> %2").arg(missed).arg(m.missed);
+        } else if (!speedOnly && !results.isEmpty()) {
+            out << "  (not in " << baselineFile << ")";
+        }
+
+        if (speeds.contains(entry)) {
+            double stepsPerSecond = speeds[entry][0].toDouble();
+            quint64 peakMemoryKB = speeds[entry][1].toULongLong();
+            if (m.stepsPerSecond < stepsPerSecond * (1.0 - SPEED_TOLERANCE))
+                problems << QString("steps/s %1 -> %2").arg(stepsPerSecond).arg(m.stepsPerSecond);
+            if (peakMemoryKB && m.peakMemoryKB > peakMemoryKB * (1.0 + MEMORY_TOLERANCE))
+                out << "  (warning: peak memory " << peakMemoryKB << " -> " << m.peakMemoryKB << " KB)";
+        }
+
+        if (!problems.isEmpty()) {
+            out << "  REGRESSED: " << problems.join(", ");
+            ++ failures;
+        }
+
+        out << "\n";
+
+    }
+
+    if (updateResults) {
+        if (!writeTable(baselineFile, "# name fill_ratio missed", resultLines)) {
+            out << "could not write " << baselineFile << "\n";
+            return 1;
+        }
+        out << "results baseline written to " << baselineFile << "\n";
+    }
+
+    if (update) {
+        if (!writeTable(speedFile, "# name steps_per_second peak_memory_kb", speedLines)) {
+            out << "could not write " << speedFile << "\n";
+            return 1;
+        }
+        out << "speed baseline written to " << speedFile << "\n";
+    }
+
+    out << (failures ? "FAIL" : "PASS") << "\n";
+    return failures ? 1 : 0;
+
+}
+
+
+int main (int argc, char *argv[]) {
+
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    int run = args.indexOf("--run");
+    if (run >= 0 && run + 1 < args.size())
+        return runOne(args[run + 1]);
+
+    int baseline = args.indexOf("--baseline");
+    QString baselineFile = (baseline >= 0 && baseline + 1 < args.size()) ? args[baseline + 1] : "baseline.txt";
+
+    int speed = args.indexOf("--speed-baseline");
+    QString speedFile = (speed >= 0 && speed + 1 < args.size()) ? args[speed + 1] : "speed-baseline.txt";
+
+    return runAll(a.applicationFilePath(), baselineFile, speedFile,
+                  args.contains("--update-baseline"), args.contains("--update-results"));
+
+}
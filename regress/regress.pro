@@ -0,0 +1,69 @@
+#MIT License
+
+#Copyright (c) 2016, Jason Cipriani
+
+#Permission is hereby granted, free of charge, to any person obtaining a copy
+#of this software and associated documentation files (the "Software"), to deal
+#in the Software without restriction, including without limitation the rights
+#to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#copies of the Software, and to permit persons to whom the Software is
+#furnished to do so, subject to the following conditions:
+
+#The above copyright notice and this permission notice shall be included in all
+#copies or substantial portions of the Software.
+
+#THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+#SOFTWARE.
+
+#-------------------------------------------------
+#
+# Scenario regression suite. "make check" builds and runs it and fails if
+# any scenario's fill ratio or missed count regressed against baseline.txt
+# (committed), or its speed (or the batch-env benchmark's env steps per
+# second) against speed-baseline.txt (in the build directory). Speeds are
+# machine specific, so run "cones-regress --update-baseline" once on each
+# machine to record them.
+# Changes that are meant to alter results rewrite baseline.txt with
+# "cones-regress --update-results --baseline baseline.txt".
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = cones-regress
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += regress.cpp \
+    ../simulator.cpp \
+    ../arrivals.cpp \
+    ../hosedrive.cpp \
+    ../scenarios.cpp \
+    ../batchenv.cpp \
+    ../latencystats.cpp \
+    ../tracelog.cpp
+
+HEADERS += ../simulator.h \
+    ../arrivals.h \
+    ../hosedrive.h \
+    ../rng.h \
+    ../scenarios.h \
+    ../batchenv.h \
+    ../latencystats.h \
+    ../tracelog.h
+
+OTHER_FILES += baseline.txt
+
+win32:LIBS += -lpsapi
+
+check.commands = ./$(TARGET) --baseline $$PWD/baseline.txt --speed-baseline speed-baseline.txt
+check.depends = $(TARGET)
+QMAKE_EXTRA_TARGETS += check
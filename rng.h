@@ -0,0 +1,88 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <QtGlobal>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Small, fast pseudo random number generator (xorshift64*, seeded through
+ * splitmix64). Each Simulator has its own, so runs are reproducible from a
+ * seed and simulators on different threads don't share qrand() state.
+ */
+//-----------------------------------------------------------------------------
+
+class Rng {
+public:
+
+    explicit Rng (quint64 seed = 0) { setSeed(seed); }
+
+    /** Restart the sequence from seed. Any seed (including 0) is fine. */
+    void setSeed (quint64 seed) {
+        quint64 z = seed + Q_UINT64_C(0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+        state_ = (z ^ (z >> 31)) | 1;
+    }
+
+    /** @return Next 64 random bits. */
+    quint64 next () {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * Q_UINT64_C(0x2545f4914f6cdd1d);
+    }
+
+    /** @return Uniform on [0, 1). */
+    double uniform () {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /** @return Uniform on [min, max). */
+    double uniform (double min, double max) {
+        return uniform() * (max - min) + min;
+    }
+
+    /** @return Exponentially distributed with the given mean. */
+    double exponential (double mean) {
+        return -log(1.0 - uniform()) * mean;
+    }
+
+private:
+
+    quint64 state_;     /**< Generator state, never 0. */
+
+};
+
+
+#endif // RNG_H
@@ -0,0 +1,231 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "scenarios.h"
+#include <QElapsedTimer>
+
+#define SCENARIO_FPS        50      /**< Timestep of all scenarios (matches the GUI). */
+#define SCENARIO_SECONDS    1800.0  /**< Default simulated length. */
+#define BURSTY_ON           6.0     /**< Same as the GUI's bursty setting. */
+#define BURSTY_OFF          4.0
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Default scenario: the GUI's default parameters, regular arrivals, constant
+ * speed hose.
+ */
+//-----------------------------------------------------------------------------
+
+Scenario::Scenario () :
+    name("defaults"),
+    params(Simulator::defaults(1.0 / SCENARIO_FPS)),
+    arrivals(Regular),
+    hoseAccel(0),
+    seed(1),
+    seconds(SCENARIO_SECONDS),
+    parallelThreshold(-1)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Set up a Simulator for this scenario. Caller owns it.
+ */
+//-----------------------------------------------------------------------------
+
+Simulator * Scenario::create (QObject *parent) const {
+
+    Simulator *sim = new Simulator(params, parent);
+    sim->setSeed(seed);
+
+    if (parallelThreshold >= 0)
+        sim->setParallelThreshold(parallelThreshold);
+
+    if (arrivals == Poisson)
+        sim->setArrivalModel(new PoissonArrivals());
+    else if (arrivals == Bursty)
+        sim->setArrivalModel(new BurstyArrivals(BURSTY_ON, BURSTY_OFF));
+
+    if (hoseAccel > 0.0) {
+        AxisLimitedDrive::Limits limits;
+        limits.maxSpeed = QVector2D(params.hoseSpeed, params.hoseSpeed);
+        limits.maxAccel = QVector2D(hoseAccel, hoseAccel);
+        sim->setHoseDrive(new AxisLimitedDrive(limits));
+    }
+
+    return sim;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Run the scenario to completion, headless.
+ */
+//-----------------------------------------------------------------------------
+
+Scenario::Result Scenario::run () const {
+
+    Simulator *sim = create();
+    Result r;
+    QElapsedTimer timer;
+    quint64 steps = (quint64)(seconds / params.timestep + 0.5);
+
+    timer.start();
+    for (r.steps = 0; r.steps < steps; ++ r.steps) {
+        sim->update();
+        r.peakCones = qMax(r.peakCones, (quint32)sim->cones().size());
+    }
+    r.wallSeconds = timer.nsecsElapsed() / 1e9;
+    r.stats = sim->stats();
+    r.fillLatency = sim->fillLatency();
+    r.idleGaps = sim->idleGaps();
+
+    delete sim;
+    return r;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  p with the belt (and drop area and hose range) widened to width,
+ *          the same way Simulator::setBeltWidth() does it.
+ */
+//-----------------------------------------------------------------------------
+
+static Simulator::Parameters withBeltWidth (Simulator::Parameters p, double width) {
+
+    p.hoseRange.adjust(0, 0, 0, width - p.beltWidth);
+    p.coneDrop.adjust(0, 0, 0, width - p.beltWidth);
+    p.beltWidth = width;
+    return p;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The reference scenarios. Names and settings are part of the regression
+ * baseline, so add new ones rather than changing existing ones.
+ */
+//-----------------------------------------------------------------------------
+
+QList<Scenario> Scenario::all () {
+
+    QList<Scenario> list;
+    Scenario s;
+
+    list << s;
+
+    s = Scenario();
+    s.name = "high-rate";
+    s.params.coneRate = 4.0;
+    list << s;
+
+    s = Scenario();
+    s.name = "wide-belt";
+    s.params = withBeltWidth(s.params, 48.0);
+    list << s;
+
+    s = Scenario();
+    s.name = "slow-hose";
+    s.params.hoseSpeed = 8.0;
+    list << s;
+
+    s = Scenario();
+    s.name = "fast-belt";
+    s.params.beltSpeed = 4.0;
+    list << s;
+
+    s = Scenario();
+    s.name = "poisson";
+    s.arrivals = Poisson;
+    list << s;
+
+    s = Scenario();
+    s.name = "bursty";
+    s.arrivals = Bursty;
+    list << s;
+
+    s = Scenario();
+    s.name = "gantry";
+    s.hoseAccel = 40.0;
+    list << s;
+
+    // lots of cones on the belt at once; mostly a speed benchmark (the belt
+    // is wide enough that the drop area never saturates)
+    s = Scenario();
+    s.name = "crowded";
+    s.params.coneRate = 40.0;
+    s.params = withBeltWidth(s.params, 256.0);
+    s.seconds = 300.0;
+    list << s;
+
+    // one very long, fast belt with tens of thousands of cones on it;
+    // benchmarks the parallel per-cone passes (the belt is fast and a bit
+    // wider so the drop area can take the rate, and the hose is faster than
+    // the belt so it can still catch cones)
+    s = Scenario();
+    s.name = "long-belt";
+    s.params.beltSpeed = 20.0;
+    s.params.hoseSpeed = 40.0;
+    s.params.coneRate = 50.0;
+    s.params = withBeltWidth(s.params, 36.0);
+    s.params.hoseRange.setWidth(10000.0);
+    s.seconds = 600.0;
+    list << s;
+
+    return list;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Look up a scenario by name.
+ *
+ * @return  False if there's no such scenario.
+ */
+//-----------------------------------------------------------------------------
+
+bool Scenario::find (const QString &name, Scenario &s) {
+
+    foreach (const Scenario &candidate, all()) {
+        if (candidate.name == name) {
+            s = candidate;
+            return true;
+        }
+    }
+
+    return false;
+
+}
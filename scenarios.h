@@ -0,0 +1,83 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef SCENARIOS_H
+#define SCENARIOS_H
+
+#include <QString>
+#include <QList>
+#include "simulator.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * A named, reproducible simulation setup: parameters, arrival process, hose
+ * drive, seed and length. Used by the regression suite (regress/) and
+ * anything else that wants runs to be comparable between builds.
+ */
+//-----------------------------------------------------------------------------
+
+struct Scenario {
+
+    /** Arrival process, see arrivals.h. */
+    enum Arrivals { Regular, Poisson, Bursty };
+
+    /** What a run measured. */
+    struct Result {
+        Simulator::Stats stats;     /**< Final totals. */
+        quint64 steps;              /**< Steps run. */
+        double wallSeconds;         /**< Wall clock time taken. */
+        quint32 peakCones;          /**< Most cones on the belt at once. */
+        QuantileSketch fillLatency; /**< Spawn-to-full times. */
+        QuantileSketch idleGaps;    /**< Hose idle gaps. */
+        Result () : steps(0), wallSeconds(0), peakCones(0) { }
+        /** @return Steps per wall clock second. */
+        double stepsPerSecond () const { return wallSeconds > 0 ? steps / wallSeconds : 0.0; }
+    };
+
+    QString name;                   /**< Unique name. */
+    Simulator::Parameters params;   /**< Initial parameters. */
+    Arrivals arrivals;              /**< Arrival process. */
+    double hoseAccel;               /**< AxisLimitedDrive acceleration, 0 = ConstantSpeedDrive. */
+    quint64 seed;                   /**< Random seed. */
+    double seconds;                 /**< Simulated run length. */
+    int parallelThreshold;          /**< Simulator::setParallelThreshold(), -1 = default. */
+
+    Scenario ();
+
+    Simulator * create (QObject *parent = 0) const;
+    Result run () const;
+
+    static QList<Scenario> all ();
+    static bool find (const QString &name, Scenario &s);
+
+};
+
+
+#endif // SCENARIOS_H
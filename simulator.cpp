@@ -32,90 +32,69 @@
 #include <QVector2D>
 #include <QDebug>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+#include <QThreadPool>
+#include <QHash>
+#include <QtCore/QtConcurrentMap>
+#include "tracelog.h"
+
+#define PLAN_CHECK_INTERVAL 32      /**< Cones between planning budget checks. */
+#define PARALLEL_THRESHOLD  8192    /**< Default Simulator::parallelThreshold(). */
+#define PLAN_CHUNK_SIZE     512     /**< Cones per parallel planning task. */
+#define SPAWN_ATTEMPTS      16      /**< Random spots tried per arrival before giving up. */
+#define SATURATION_HOLD     1.0     /**< How long saturated() stays on after a drop (seconds). */
 
 
 //-----------------------------------------------------------------------------
 /**
- * @return  A random number between min and max.
+ * Orders cones (and belt positions) by X, for searching Simulator::byX_.
  */
 //-----------------------------------------------------------------------------
 
-static double randf (double min, double max) {
-
-    return (double)qrand() / (double)RAND_MAX * (max - min) + min;
-
-}
+struct ConeXLess {
+    bool operator() (const Simulator::Cone *a, const Simulator::Cone *b) const { return a->pos.x() < b->pos.x(); }
+    bool operator() (const Simulator::Cone *a, double x) const { return a->pos.x() < x; }
+    bool operator() (double x, const Simulator::Cone *a) const { return x < a->pos.x(); }
+};
 
 
 //-----------------------------------------------------------------------------
 /**
- * Given cone position and velocity, and hose position and speed, calculates
- * the point that the hose can intercept the cone and the time it will take to
- * get there. Math is from http://stackoverflow.com/a/2249237.
- *
- * @param   cone        Cone position.
- * @param   coneVel     Cone velocity (per second).
- * @param   hose        Hose head position.
- * @param   hoseSpeed   Hose head speed (per second).
- * @param   tout        If not NULL, will contain movement time.
- * @return  The interception point, or a null vector if no solution exists. The
- *          hose direction and velocity can be calculated from this, hose, and
- *          tout.
+ * Spawn grid cell containing a position. Cells are the size of a cone and in
+ * belt coordinates (world X minus the belt's total travel), so a cone stays
+ * in the cell it spawned in.
  */
 //-----------------------------------------------------------------------------
 
-static QVector2D intercept (const QVector2D &cone,
-                            const QVector2D &coneVel,
-                            const QVector2D &hose,
-                            double hoseSpeed,
-                            double *tout)
-{
+static void spawnCell (const QPointF &pos, double travel, qint64 &ix, qint64 &iy) {
 
-    /* from http://stackoverflow.com/a/2249237
-    a := sqr(target.velocityX) + sqr(target.velocityY) - sqr(projectile_speed)
-    b := 2 * (target.velocityX * (target.startX - cannon.X)
-              + target.velocityY * (target.startY - cannon.Y))
-    c := sqr(target.startX - cannon.X) + sqr(target.startY - cannon.Y)
-    disc := sqr(b) - 4 * a * c
-    t1 := (-b + sqrt(disc)) / (2 * a)
-    t2 := (-b - sqrt(disc)) / (2 * a)
-    aim.X := t * target.velocityX + target.startX
-    aim.Y := t * target.velocityY + target.startY
-    */
-
-    QVector2D hoseToCone = cone - hose;
-
-    double a = coneVel.lengthSquared() - hoseSpeed * hoseSpeed;
-    double b = 2.0 * QVector2D::dotProduct(coneVel, hoseToCone);
-    double c = hoseToCone.lengthSquared();
-    double disc = b * b - 4 * a * c;
-
-    if (disc < 0.0)
-        return QVector2D();
-
-    double sqrt_disc = sqrt(disc);
-    double t1 = (-b + sqrt_disc) / (2.0 * a);
-    double t2 = (-b - sqrt_disc) / (2.0 * a);
-    double t;
-
-    if (t1 < 0.0)
-        t = t2;
-    else if (t2 < 0.0)
-        t = t1;
-    else
-        t = qMin(t1, t2);
+    ix = (qint64)std::floor((pos.x() - travel) / CONE_WIDTH);
+    iy = (qint64)std::floor(pos.y() / CONE_HEIGHT);
+
+}
 
-    if (t < 0.0)
-        return QVector2D();
 
-    if (tout)
-        *tout = t;
+static qint64 spawnKey (qint64 ix, qint64 iy) {
 
-    return coneVel * t + cone;
+    return (qint64)(((quint64)ix << 32) | (quint32)iy);
 
 }
 
 
+//-----------------------------------------------------------------------------
+/**
+ * Moves a cone along the belt, for QtConcurrent::blockingMap().
+ */
+//-----------------------------------------------------------------------------
+
+struct AdvanceCone {
+    double dx;
+    explicit AdvanceCone (double dx) : dx(dx) { }
+    void operator() (Simulator::Cone *cone) const { cone->pos.rx() += dx; }
+};
+
+
 //-----------------------------------------------------------------------------
 /**
  * Construct a Simulator from the given configuration. Everything is ready to
@@ -130,11 +109,50 @@ Simulator::Simulator (const Parameters &p, QObject *parent) :
     QObject(parent),
     p_(p),
     t_(0),
-    newconet_(0),
-    hose_(p.hoseRange.center())
+    arrivals_(new RegularArrivals()),
+    exhausted_(false),
+    hose_(p.hoseRange.center()),
+    drive_(new ConstantSpeedDrive(p.hoseSpeed)),
+    planBudget_(0),
+    degraded_(false),
+    parallelThreshold_(PARALLEL_THRESHOLD),
+    nextid_(0),
+    external_(false),
+    rng_(QDateTime::currentMSecsSinceEpoch()),
+    idleSince_(0),
+    beltTravel_(0),
+    lastBlocked_(0)
 {
 
-    qsrand(QDateTime::currentMSecsSinceEpoch());
+    drive_->moveTo(QVector2D(hose_.pos), QVector2D(), true);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The standard setup used by the GUI: a 24 wide belt with the hose range
+ * starting at X=12 and the drop area behind X=-12. See SimulatorView for how
+ * this lines up with the view.
+ *
+ * @param   timestep    Simulation timestep (seconds).
+ * @return  Default parameters.
+ */
+//-----------------------------------------------------------------------------
+
+Simulator::Parameters Simulator::defaults (double timestep) {
+
+    Parameters p;
+    p.timestep = timestep;
+    p.beltWidth = 24.0;
+    p.beltSpeed = 2.0;
+    p.coneRate = 1.7;
+    p.coneDrop = QRectF(-36, 0, 24, p.beltWidth).adjusted(0, 2, 0, -2);
+    p.hoseRange = QRectF(12, 0, 36, p.beltWidth).adjusted(0, 1, 0, -1);
+    p.hoseFillRate = 3.0;
+    p.hoseSpeed = 20.0;
+    p.urgentTime = 3.0;
+    return p;
 
 }
 
@@ -148,6 +166,178 @@ Simulator::Simulator (const Parameters &p, QObject *parent) :
 Simulator::~Simulator () {
 
     qDeleteAll(cones_);
+    delete arrivals_;
+    delete drive_;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Make an independent copy of the whole simulation as it is right now:
+ * cones, hose, arrival model, drive, random number state and statistics.
+ * Updating the copy gives the same results as updating this one would, so
+ * it can be used to look ahead (e.g. Forecast) on another thread. Caller
+ * owns it.
+ */
+//-----------------------------------------------------------------------------
+
+Simulator * Simulator::clone (QObject *parent) const {
+
+    Simulator *sim = new Simulator(p_, parent);
+
+    delete sim->arrivals_;
+    sim->arrivals_ = arrivals_->clone();
+    delete sim->drive_;
+    sim->drive_ = drive_->clone();
+
+    QHash<const Cone *, Cone *> copies;
+    foreach (const Cone *cone, cones_) {
+        Cone *copy = new Cone(*cone);
+        copies.insert(cone, copy);
+        sim->cones_.push_back(copy);
+        sim->spawnGrid_.insert(copy->cell, copy);
+    }
+    foreach (const Cone *cone, byX_)
+        sim->byX_.push_back(copies.value(cone));
+
+    sim->t_ = t_;
+    sim->next_ = next_;
+    sim->exhausted_ = exhausted_;
+    sim->hose_ = hose_;
+    sim->hose_.target = copies.value(hose_.target, NULL);
+    sim->planBudget_ = planBudget_;
+    sim->degraded_ = degraded_;
+    sim->parallelThreshold_ = parallelThreshold_;
+    sim->nextid_ = nextid_;
+    sim->external_ = external_;
+    sim->command_ = command_;
+    sim->rng_ = rng_;
+    sim->stats_ = stats_;
+    sim->fillLatency_ = fillLatency_;
+    sim->idleGaps_ = idleGaps_;
+    sim->idleSince_ = idleSince_;
+    sim->beltTravel_ = beltTravel_;
+    sim->lastBlocked_ = lastBlocked_;
+
+    return sim;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Start over at time 0 with an empty belt, as if just constructed with the
+ * current parameters. The arrival model is rewound and the hose drive,
+ * plan budget, parallel threshold and external control setting are kept.
+ * For running many episodes without making a new Simulator for each. Will
+ * invalidate all Cone pointers.
+ *
+ * @param   seed    New random seed, see setSeed().
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::reset (quint64 seed) {
+
+    qDeleteAll(cones_);
+    cones_.clear();
+    byX_.clear();
+    spawnGrid_.clear();
+
+    t_ = 0;
+    arrivals_->reset();
+    next_ = ArrivalModel::Arrival();
+    exhausted_ = false;
+    hose_ = Hose(p_.hoseRange.center());
+    drive_->moveTo(QVector2D(hose_.pos), QVector2D(), true);
+    degraded_ = false;
+    nextid_ = 0;
+    command_ = HoseCommand();
+    rng_.setSeed(seed);
+    stats_ = Stats();
+    fillLatency_.clear();
+    idleGaps_.clear();
+    idleSince_ = 0;
+    beltTravel_ = 0;
+    lastBlocked_ = 0;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Copy everything needed to draw sim as it is right now.
+ */
+//-----------------------------------------------------------------------------
+
+Simulator::Snapshot::Snapshot (const Simulator &sim) :
+    t(sim.t_),
+    params(sim.p_),
+    hose(sim.hose_)
+{
+
+    hose.target = NULL;
+    foreach (const Cone *cone, sim.cones_) {
+        cones.push_back(new Cone(*cone));
+        if (cone == sim.hose_.target)
+            hose.target = cones.back();
+    }
+
+}
+
+
+Simulator::Snapshot::~Snapshot () {
+
+    qDeleteAll(cones);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Replace the cone arrival process. The first arrival from the new model is
+ * scheduled relative to the current timestamp.
+ *
+ * @param   model   New arrival model. Simulator takes ownership. Must not be
+ *                  NULL.
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::setArrivalModel (ArrivalModel *model) {
+
+    delete arrivals_;
+    arrivals_ = model;
+    next_ = ArrivalModel::Arrival();
+    next_.t = t_;
+    exhausted_ = !arrivals_->next(p_.coneRate, rng_, next_);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Replace the hose motion model. The new drive is placed at the current hose
+ * position. If the hose is filling it is also matched to the target's
+ * velocity, otherwise it starts at rest and the current movement is
+ * restarted on the next update().
+ *
+ * @param   drive   New drive. Simulator takes ownership. Must not be NULL.
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::setHoseDrive (HoseDrive *drive) {
+
+    delete drive_;
+    drive_ = drive;
+
+    if (hose_.state == Hose::Filling) {
+        drive_->moveTo(QVector2D(hose_.pos), QVector2D(p_.beltSpeed, 0), true);
+    } else {
+        drive_->moveTo(QVector2D(hose_.pos), QVector2D(), true);
+        if (hose_.state == Hose::Approaching)
+            drive_->moveTo(QVector2D(hose_.target->pos), QVector2D(p_.beltSpeed, 0), false);
+        hose_.arrived = drive_->arrived();
+    }
 
 }
 
@@ -161,6 +351,8 @@ Simulator::~Simulator () {
 
 void Simulator::update () {
 
+    TRACE_SPAN("Simulator::update");
+
     updateCones();
     updateHose(hose_);
     t_ += p_.timestep;
@@ -170,39 +362,254 @@ void Simulator::update () {
 
 //-----------------------------------------------------------------------------
 /**
- * Updates cones for this frame. Moves the cones, creates new ones, kills old
- * ones. May invalidate some Cone pointers (as they die). Currently the
- * the position on the belt at which cones die is chosen to correspond with a
- * location just beyond the end of the view bounds that I use in SimulatorView.
+ * @return  True if this step's per-cone work should be split across threads.
+ */
+//-----------------------------------------------------------------------------
+
+bool Simulator::parallel () const {
+
+    return parallelThreshold_ > 0 && cones_.size() >= parallelThreshold_ &&
+           QThreadPool::globalInstance()->maxThreadCount() > 1;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Updates cones for this frame. Moves the cones, creates new ones (when the
+ * ArrivalModel says so), kills old ones. May invalidate some Cone pointers
+ * (as they die). Currently the position on the belt at which cones die is
+ * chosen to correspond with a location just beyond the end of the view
+ * bounds that I use in SimulatorView.
+ *
+ * The dying cones are found by binary search at the end of byX_ and removed
+ * from cones_ in a single compacting pass, so a step costs the same however
+ * many cones die in it. Moving the survivors is split across the thread pool
+ * when parallel().
+ *
+ * Cones that cross the far edge of the hose range unfilled are counted in
+ * Stats::escaped as they cross, with another binary search.
+ *
+ * Randomly placed cones don't overlap each other: each arrival tries a few
+ * spots in the drop area (see spawnRoom()) and is dropped if none of them
+ * are free, see saturated(). Cones placed by the arrival model (traces) go
+ * exactly where they're told.
  */
 //-----------------------------------------------------------------------------
 
 void Simulator::updateCones () {
 
+    TRACE_SPAN("Simulator::updateCones");
+
     // kinda arbitrary, based on view auto bounds
     double diepos = p_.hoseRange.right() + (p_.hoseRange.left() - p_.coneDrop.right()) + 2.0;
 
-    // move / kill cones
-    for (QList<Cone *>::iterator i = cones_.begin(); i != cones_.end(); ) {
-        if ((*i)->pos.x() > diepos) {
-            delete *i;
-            i = cones_.erase(i);
-        } else {
-            (*i)->pos.rx() += p_.beltSpeed * p_.timestep;
-            ++ i;
+    // kill cones
+    QList<Cone *>::iterator dead = qUpperBound(byX_.begin(), byX_.end(), diepos, ConeXLess());
+    if (dead != byX_.end()) {
+        for (QList<Cone *>::iterator i = dead; i != byX_.end(); ++ i) {
+            if (*i == hose_.target) {
+                hose_.target = NULL;
+                hose_.state = Hose::Idle;
+            }
+            if ((*i)->fill >= 1.0)
+                ++ stats_.filled;
+            else
+                ++ stats_.missed;
+            spawnGrid_.remove((*i)->cell, *i);
         }
+        // one compacting pass over cones_, same test as the search above
+        int kept = 0;
+        for (int n = 0; n < cones_.size(); ++ n)
+            if (!(diepos < cones_[n]->pos.x()))
+                cones_[kept ++] = cones_[n];
+        cones_.erase(cones_.begin() + kept, cones_.end());
+        qDeleteAll(dead, byX_.end());
+        byX_.erase(dead, byX_.end());
     }
 
+    // move cones
+    AdvanceCone advance(p_.beltSpeed * p_.timestep);
+    beltTravel_ += advance.dx;
+    if (parallel())
+        QtConcurrent::blockingMap(byX_, advance);
+    else
+        foreach (Cone *cone, byX_)
+            advance(cone);
+
+    // count cones that just left the hose range unfilled
+    QList<Cone *>::iterator first = qUpperBound(byX_.begin(), byX_.end(), p_.hoseRange.right(), ConeXLess());
+    QList<Cone *>::iterator last = qUpperBound(first, byX_.end(), p_.hoseRange.right() + advance.dx, ConeXLess());
+    for (; first != last; ++ first)
+        if ((*first)->fill < 1.0)
+            ++ stats_.escaped;
+
     // spawn new cones
-    while (t_ >= newconet_) {
-        newconet_ += 1.0 / p_.coneRate;
-        cones_.push_back(new Cone(randf(p_.coneDrop.left(), p_.coneDrop.right()),
-                                  randf(p_.coneDrop.top(), p_.coneDrop.bottom())));
+    while (!exhausted_ && t_ >= next_.t) {
+        if (next_.placed) {
+            addCone(new Cone(next_.pos.x(), next_.pos.y(), nextid_ ++, t_));
+            ++ stats_.spawned;
+        } else {
+            // try a few random spots that don't overlap another cone
+            QPointF pos;
+            int attempt;
+            for (attempt = 0; attempt < SPAWN_ATTEMPTS; ++ attempt) {
+                // separate statements so the draw order is well defined
+                pos.setX(rng_.uniform(p_.coneDrop.left(), p_.coneDrop.right()));
+                pos.setY(rng_.uniform(p_.coneDrop.top(), p_.coneDrop.bottom()));
+                if (spawnRoom(pos))
+                    break;
+            }
+            if (attempt < SPAWN_ATTEMPTS) {
+                addCone(new Cone(pos.x(), pos.y(), nextid_ ++, t_));
+                ++ stats_.spawned;
+            } else {
+                ++ stats_.blocked;
+                lastBlocked_ = t_;
+            }
+        }
+        exhausted_ = !arrivals_->next(p_.coneRate, rng_, next_);
     }
 
 }
 
 
+//-----------------------------------------------------------------------------
+/**
+ * Checks whether a cone can be dropped at pos without overlapping another
+ * one. Cones are at most one per spawn grid cell (unless a trace put them
+ * there), so this only looks at the few cones in the 3x3 cells around pos
+ * no matter how crowded the belt is.
+ *
+ * @return  True if there's room.
+ */
+//-----------------------------------------------------------------------------
+
+bool Simulator::spawnRoom (const QPointF &pos) const {
+
+    qint64 cx, cy;
+    spawnCell(pos, beltTravel_, cx, cy);
+
+    for (qint64 ix = cx - 1; ix <= cx + 1; ++ ix) {
+        for (qint64 iy = cy - 1; iy <= cy + 1; ++ iy) {
+            qint64 key = spawnKey(ix, iy);
+            QMultiHash<qint64, Cone *>::const_iterator i = spawnGrid_.find(key);
+            for (; i != spawnGrid_.end() && i.key() == key; ++ i) {
+                if (qAbs(i.value()->pos.x() - pos.x()) < CONE_WIDTH &&
+                    qAbs(i.value()->pos.y() - pos.y()) < CONE_HEIGHT)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Add a new cone to cones_, to its place in byX_, and to the spawn grid.
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::addCone (Cone *cone) {
+
+    qint64 ix, iy;
+    spawnCell(cone->pos, beltTravel_, ix, iy);
+    cone->cell = spawnKey(ix, iy);
+
+    cones_.push_back(cone);
+    byX_.insert(qUpperBound(byX_.begin(), byX_.end(), cone, ConeXLess()), cone);
+    spawnGrid_.insert(cone->cell, cone);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Drop area saturation: randomly placed arrivals are dropped (and counted in
+ * Stats::blocked) when there's no room left in the drop area for them, which
+ * means the cone rate is more than the drop area can physically take.
+ *
+ * @return  True if an arrival was dropped recently.
+ */
+//-----------------------------------------------------------------------------
+
+bool Simulator::saturated () const {
+
+    return stats_.blocked > 0 && t_ - lastBlocked_ < SATURATION_HOLD;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Binary search on cone positions, for walking conesByX() from a given X
+ * without copying anything.
+ *
+ * @return  Number of cones with x <= the given x, which is also the
+ *          conesByX() index of the first cone past it.
+ */
+//-----------------------------------------------------------------------------
+
+int Simulator::conesUpTo (double x) const {
+
+    return qUpperBound(byX_.begin(), byX_.end(), x, ConeXLess()) - byX_.begin();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Range query on cone positions. Cheap (log n plus the size of the result), so
+ * it's what views should use rather than scanning cones().
+ *
+ * @return  Cones with xmin <= x <= xmax, in order of increasing x.
+ */
+//-----------------------------------------------------------------------------
+
+QList<Simulator::Cone *> Simulator::conesInRange (double xmin, double xmax) const {
+
+    QList<Cone *>::const_iterator first = qLowerBound(byX_.begin(), byX_.end(), xmin, ConeXLess());
+    QList<Cone *>::const_iterator last = qUpperBound(first, byX_.end(), xmax, ConeXLess());
+    QList<Cone *> result;
+
+    result.reserve(last - first);
+    for (; first != last; ++ first)
+        result.push_back(*first);
+
+    return result;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Cone counts for bins evenly spaced over [xmin, xmax). Costs one binary
+ * search per bin regardless of how many cones there are.
+ *
+ * @return  Count per bin, bins entries.
+ */
+//-----------------------------------------------------------------------------
+
+QVector<int> Simulator::coneDensity (double xmin, double xmax, int bins) const {
+
+    QVector<int> counts(qMax(0, bins));
+    double width = (xmax - xmin) / bins;
+    QList<Cone *>::const_iterator prev = qLowerBound(byX_.begin(), byX_.end(), xmin, ConeXLess());
+
+    for (int n = 0; n < bins; ++ n) {
+        QList<Cone *>::const_iterator next = qLowerBound(prev, byX_.end(), xmin + (n + 1) * width, ConeXLess());
+        counts[n] = next - prev;
+        prev = next;
+    }
+
+    return counts;
+
+}
+
+
 //-----------------------------------------------------------------------------
 /**
  * Update hose position. This is where the filling algorithm is implemented,
@@ -210,9 +617,12 @@ void Simulator::updateCones () {
  * algorithm. It is responsible for:
  *
  * - Analyzing current cone positions.
- * - Moving the hose.
+ * - Moving the hose (by telling the HoseDrive where to go).
  * - Filling the cones (by modifying Cone::fill).
  *
+ * Travel times and fill points come from the HoseDrive too, so the plan uses
+ * the same motion model that actually moves the hose.
+ *
  * This is the only place in the Simulator code that really uses the member
  * fields of Hose (and currently stores a few things in Cone as well). So you
  * can add/remove members to those structs as you see fit except you will also
@@ -222,62 +632,75 @@ void Simulator::updateCones () {
  * The reason h is passed as a parameter instead of just using hose_ is that I
  * was originally thinking of supporting multiple hose heads. Might be a fun
  * feature to add.
+ *
+ * If a planning budget is set (setPlanBudget()) and the candidate scan runs
+ * over it, the scan stops early and the best target found so far is used.
+ * Cones are scanned oldest first, i.e. the ones closest to leaving go first,
+ * so the cut-down decision is still a sensible one. This is what lets
+ * ControlLoop keep its deadlines with lots of cones on the belt.
+ *
+ * When parallel(), the scan is split into chunks of cones_ that run on the
+ * thread pool (see scanChunk()), and the results are combined in chunk order
+ * so the choice is exactly what the serial scan would make. Under a budget
+ * every chunk stops at the deadline, so a cut-down scan may skip cones from
+ * the middle of the list instead of only the end.
  */
 //-----------------------------------------------------------------------------
 
 void Simulator::updateHose (Hose &h) {
 
-    if (h.state == Hose::Idle && !h.target) {
+    TRACE_SPAN("Simulator::updateHose");
+
+    QVector2D coneVel(p_.beltSpeed, 0);
+
+    degraded_ = false;
+
+    if (external_) {
+
+        followCommand(h);
+
+    } else if (h.state == Hose::Idle && !h.target) {
 
         QList<Cone *> urgent;
         double closesttime = 0.0;
+        QElapsedTimer planTimer;
+        QVector<PlanChunk> chunks;
+        PlanChunk chunk;
+
+        if (planBudget_ > 0)
+            planTimer.start();
+
+        chunk.sim = this;
+        chunk.timer = (planBudget_ > 0 ? &planTimer : NULL);
+        chunk.best = NULL;
+        chunk.cut = false;
 
         // find the closest cone that we can move to and fill up in time
-        foreach (Cone *cone, cones_) {
-            cone->status = Cone::Boring;
-            if (cone->fill >= 1.0) {
-                cone->status = Cone::AlreadyFull;
-                continue;
-            }
-            // time cone has before it moves out of range
-            double timelimit = (p_.hoseRange.right() - cone->pos.x()) / p_.beltSpeed;
-            // time cone will require to fill up
-            double filltime = (1.0 - cone->fill) / p_.hoseFillRate;
-            if (filltime > timelimit) {
-                cone->status = Cone::CantFill;
-                continue;
-            }
-            // time it will take hose to get to cone, predicting where the cone will be
-            double movetime;
-            QVector2D fillpoint = intercept(QVector2D(cone->pos),
-                                            QVector2D(p_.beltSpeed, 0),
-                                            QVector2D(hose_.pos),
-                                            p_.hoseSpeed, &movetime);
-            if (fillpoint.isNull() || !p_.hoseRange.contains(fillpoint.toPointF())) {
-                cone->status = Cone::CantFill;
-                continue;
+        if (parallel()) {
+            for (int n = 0; n < cones_.size(); n += PLAN_CHUNK_SIZE) {
+                chunk.begin = n;
+                chunk.end = qMin(n + PLAN_CHUNK_SIZE, cones_.size());
+                chunks.push_back(chunk);
             }
-            double totaltime = filltime + movetime;
-            if (totaltime > timelimit) {
-                cone->status = Cone::CantFill;
-                continue;
-            }
-            // ok so its a candidate
-            if (!h.target || totaltime < closesttime) {
-                closesttime = totaltime;
-                h.target = cone;
+            QtConcurrent::blockingMap(chunks, &Simulator::scanChunk);
+        } else {
+            chunk.begin = 0;
+            chunk.end = cones_.size();
+            chunks.push_back(chunk);
+            scanChunk(chunks.back());
+        }
+
+        // combine in cones_ order, earliest wins ties, same as a serial scan
+        foreach (const PlanChunk &c, chunks) {
+            if (c.best && (!h.target || c.best->totaltime < closesttime)) {
+                closesttime = c.best->totaltime;
+                h.target = c.best;
                 h.state = Hose::Approaching;
                 h.arrived = false;
-                h.dest = fillpoint;
-            }
-            // stragglers
-            if (timelimit - totaltime < p_.urgentTime) {
-                cone->totaltime = totaltime;
-                cone->fillpoint = fillpoint;
-                cone->timelimit = timelimit;
-                cone->status = Cone::Urgent;
-                urgent.push_back(cone);
+                h.dest = c.best->fillpoint;
             }
+            urgent += c.urgent;
+            degraded_ = degraded_ || c.cut;
         }
 
         // stragglers
@@ -304,41 +727,163 @@ void Simulator::updateHose (Hose &h) {
             h.urgentmode = false;
         }
 
+        if (h.target)
+            drive_->moveTo(QVector2D(h.target->pos), coneVel, false);
+
     }
 
-    // if idle, drift towards inlet center
-    // note: lazy logic will immediately set arrived = true again if we're already
-    // there but who cares.
+    // if idle, drift towards inlet center (or wherever we're told)
     if (h.state == Hose::Idle) {
-        h.arrived = false;
-        h.dest = QVector2D(p_.hoseRange.left(), p_.hoseRange.center().y());
+        if (external_)
+            h.dest = command_.dest;
+        else
+            h.dest = QVector2D(p_.hoseRange.left(), p_.hoseRange.center().y());
+        drive_->moveTo(h.dest, QVector2D(), false);
     }
 
     if (h.state == Hose::Idle || h.state == Hose::Approaching) {
-        if (!h.arrived) {
-            QVector2D todest = h.dest - QVector2D(h.pos);
-            double dist = p_.hoseSpeed * p_.timestep;
-            if (dist > todest.length()) {
-                h.pos = h.dest.toPointF();
-                h.arrived = true;
-            } else {
-                h.pos += (todest.normalized() * dist).toPointF();
-            }
-        }
+        drive_->update(p_.timestep);
+        h.pos = drive_->pos().toPointF();
+        h.arrived = drive_->arrived();
     }
 
     if (h.state == Hose::Approaching && h.arrived) {
         h.state = Hose::Filling;
+        idleGaps_.add(t_ - idleSince_);
     }
 
     if (h.state == Hose::Filling) {
         h.pos = h.target->pos;
+        drive_->moveTo(QVector2D(h.pos), coneVel, true);
         h.target->fill += p_.hoseFillRate * p_.timestep;
         if (h.target->fill >= 1.0) {
             h.target->fill = 1.0;
+            ++ stats_.completed;
+            fillLatency_.add(t_ + p_.timestep - h.target->born);
+            idleSince_ = t_ + p_.timestep;
             h.target = NULL;
             h.state = Hose::Idle;
         }
     }
 
 }
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The per-cone part of the target selection in updateHose(), over one range
+ * of cones_. Sets each cone's status (and totaltime, timelimit and fillpoint
+ * for candidates), and records the chunk's quickest candidate and its urgent
+ * cones. Only reads the Simulator and only writes to cones in the range, so
+ * chunks can run concurrently.
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::scanChunk (PlanChunk &c) {
+
+    TRACE_SPAN("Simulator::scanChunk");
+
+    const Parameters &p = c.sim->p_;
+    const HoseDrive *drive = c.sim->drive_;
+    QVector2D coneVel(p.beltSpeed, 0);
+    int scanned = 0;
+
+    for (int n = c.begin; n < c.end; ++ n) {
+        Cone *cone = c.sim->cones_[n];
+        if (c.timer && ++ scanned % PLAN_CHECK_INTERVAL == 0 &&
+            c.timer->nsecsElapsed() > c.sim->planBudget_) {
+            c.cut = true;
+            break;
+        }
+        cone->status = Cone::Boring;
+        if (cone->fill >= 1.0) {
+            cone->status = Cone::AlreadyFull;
+            continue;
+        }
+        // time cone has before it moves out of range
+        double timelimit = (p.hoseRange.right() - cone->pos.x()) / p.beltSpeed;
+        // time cone will require to fill up
+        double filltime = (1.0 - cone->fill) / p.hoseFillRate;
+        if (filltime > timelimit) {
+            cone->status = Cone::CantFill;
+            continue;
+        }
+        // time it will take hose to get to cone, predicting where the cone will be
+        double movetime;
+        QVector2D fillpoint = drive->calcIntercept(QVector2D(cone->pos), coneVel, &movetime);
+        if (fillpoint.isNull() || !p.hoseRange.contains(fillpoint.toPointF())) {
+            cone->status = Cone::CantFill;
+            continue;
+        }
+        double totaltime = filltime + movetime;
+        if (totaltime > timelimit) {
+            cone->status = Cone::CantFill;
+            continue;
+        }
+        // ok so its a candidate
+        cone->totaltime = totaltime;
+        cone->fillpoint = fillpoint;
+        cone->timelimit = timelimit;
+        if (!c.best || totaltime < c.best->totaltime)
+            c.best = cone;
+        // stragglers
+        if (timelimit - totaltime < p.urgentTime) {
+            cone->status = Cone::Urgent;
+            c.urgent.push_back(cone);
+        }
+    }
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The external control replacement for the planning part of updateHose().
+ * Applies command_: a target cone starts (or redirects) an approach, no
+ * target means go idle. A fill in progress is always finished first, unless
+ * its cone leaves the hose range. Unknown or already full cones are ignored.
+ * A target is accepted exactly when the planner could pick it: the hose can
+ * intercept it inside the hose range (even if it's still upstream of it). It
+ * is re-checked every step and the hose goes idle once it can't be reached,
+ * so the controller is held to the same rules as updateHose().
+ */
+//-----------------------------------------------------------------------------
+
+void Simulator::followCommand (Hose &h) {
+
+    QVector2D coneVel(p_.beltSpeed, 0);
+
+    if (h.state == Hose::Filling) {
+        if (p_.hoseRange.contains(h.target->pos))
+            return;
+        h.target = NULL;
+        h.state = Hose::Idle;
+    }
+
+    Cone *target = NULL;
+    QVector2D fillpoint;
+    if (command_.hasTarget) {
+        foreach (Cone *cone, cones_) {
+            if (cone->id == command_.targetId) {
+                if (cone->fill < 1.0) {
+                    fillpoint = drive_->calcIntercept(QVector2D(cone->pos), coneVel, NULL);
+                    if (!fillpoint.isNull() && p_.hoseRange.contains(fillpoint.toPointF()))
+                        target = cone;
+                }
+                break;
+            }
+        }
+    }
+
+    if (target && target != h.target) {
+        h.target = target;
+        h.state = Hose::Approaching;
+        h.arrived = false;
+        h.dest = fillpoint;
+        drive_->moveTo(QVector2D(target->pos), coneVel, false);
+    } else if (!target) {
+        h.target = NULL;
+        h.state = Hose::Idle;
+    }
+
+}
@@ -31,9 +31,19 @@
 
 #include <QObject>
 #include <QList>
+#include <QVector>
 #include <QRect>
 #include <QPoint>
 #include <QVector2D>
+#include <QElapsedTimer>
+#include <QMultiHash>
+#include "arrivals.h"
+#include "hosedrive.h"
+#include "rng.h"
+#include "latencystats.h"
+
+#define CONE_WIDTH          1.5     /**< Cone footprint on the belt (X). */
+#define CONE_HEIGHT         2.0     /**< Cone footprint on the belt (Y). */
 
 
 //-----------------------------------------------------------------------------
@@ -67,7 +77,10 @@ public:
     struct Cone {
         QPointF pos;    /**< Position. */
         double fill;    /**< Amount of ice cream (0 to 1). */
-        Cone (double x, double y) : pos(x, y), fill(0), status(Boring) { }
+        quint32 id;     /**< Unique (until it wraps) id, in spawn order. */
+        double born;    /**< Spawn timestamp. */
+        qint64 cell;    /**< Spawn grid cell, see Simulator::addCone(). */
+        Cone (double x, double y, quint32 id, double born) : pos(x, y), fill(0), id(id), born(born), cell(0), status(Boring) { }
         // Some stuff used by updateHose():
         enum Status { Boring, AlreadyFull, CantFill, Urgent };
         double totaltime;
@@ -76,17 +89,6 @@ public:
         Status status; // read by SimulatorView *only*!
     };
 
-#if 0 // work in progress
-    class HoseDrive {
-    public:
-        virtual ~HoseDrive () { }
-        virtual void moveTo (const QVector2D &pos, bool instant) = 0;
-        virtual bool arrived () const = 0;
-        virtual double calcTime (const QVector2D &pos) const = 0;
-        virtual QVector2D calcIntercept
-    };
-#endif
-
     /** A hose head. */
     struct Hose {
         QPointF pos;    /**< Position. */
@@ -96,22 +98,125 @@ public:
         enum State { Idle, Approaching, Filling };
         State state;    /**< Current state. */
         QVector2D dest; /**< Current movement destination (Idle, Approaching). */
-        bool arrived;   /**< Arrived at destination? (Idle, Approaching) */
+        bool arrived;   /**< Arrived at destination? (Idle, Approaching) Mirrors HoseDrive::arrived(). */
         bool urgentmode;/**< Handling "urgent" cones? */
     };
 
+    /** A hose command from an external controller, see setExternalControl(). */
+    struct HoseCommand {
+        bool hasTarget;     /**< If true, go fill targetId, otherwise go to dest. */
+        quint32 targetId;   /**< Cone::id of the cone to fill. */
+        QVector2D dest;     /**< Idle position, if !hasTarget. */
+        HoseCommand () : hasTarget(false), targetId(0) { }
+    };
+
+    /** A deep copy of the drawable state, so it can be drawn (e.g. on another
+     *  thread) while the simulation moves on. hose.target points into cones. */
+    class Snapshot {
+    public:
+        explicit Snapshot (const Simulator &sim);
+        ~Snapshot ();
+        double t;               /**< Timestamp. */
+        Parameters params;      /**< Parameters. */
+        Hose hose;              /**< Hose head. */
+        QList<Cone *> cones;    /**< Copies of all the cones (owned). */
+    private:
+        Q_DISABLE_COPY(Snapshot)
+    };
+
     explicit Simulator (const Parameters &p, QObject *parent = 0);
     ~Simulator ();
 
+    static Parameters defaults (double timestep);
+
+    Simulator * clone (QObject *parent = 0) const;
+
     /** @return Current list of cones. Do not delete these. */
     const QList<Cone *> & cones () const { return cones_; }
 
+    /** @return The same cones in order of increasing x. Do not delete these. */
+    const QList<Cone *> & conesByX () const { return byX_; }
+
+    int conesUpTo (double x) const;
+    QList<Cone *> conesInRange (double xmin, double xmax) const;
+    QVector<int> coneDensity (double xmin, double xmax, int bins) const;
+
     /** @return Current parameters. */
     const Parameters & params () const { return p_; }
 
     /** @return Current hose head info. */
     const Hose & hose () const { return hose_; }
 
+    /** @return Current arrival model. */
+    const ArrivalModel * arrivalModel () const { return arrivals_; }
+
+    /** @return True if the arrival model has run out of arrivals (traces). */
+    bool arrivalsExhausted () const { return exhausted_; }
+
+    void setArrivalModel (ArrivalModel *model);
+
+    /** @return Current hose drive. */
+    const HoseDrive * hoseDrive () const { return drive_; }
+
+    void setHoseDrive (HoseDrive *drive);
+
+    /** Limit the time updateHose() may spend choosing a target, in
+     *  nanoseconds (0 = unlimited). See updateHose(). */
+    void setPlanBudget (qint64 nsecs) { planBudget_ = nsecs; }
+
+    /** @return True if the last update() ran out of planning budget. */
+    bool lastStepDegraded () const { return degraded_; }
+
+    /** Split the per-cone work in update() across the global QThreadPool
+     *  once there are at least this many cones (0 = never). See
+     *  updateCones() and updateHose(). */
+    void setParallelThreshold (int cones) { parallelThreshold_ = cones; }
+
+    /** @return Current parallel threshold. */
+    int parallelThreshold () const { return parallelThreshold_; }
+
+    /** @return Current timestamp. */
+    double time () const { return t_; }
+
+    /** Restart the random number sequence, for reproducible runs. Call
+     *  before the first update(). */
+    void setSeed (quint64 seed) { rng_.setSeed(seed); }
+
+    void reset (quint64 seed);
+
+    /** Running totals. */
+    struct Stats {
+        quint64 spawned;    /**< Cones created. */
+        quint64 filled;     /**< Cones that left the belt full. */
+        quint64 missed;     /**< Cones that left the belt not full. */
+        quint64 blocked;    /**< Arrivals dropped for lack of room in the drop area. */
+        quint64 completed;  /**< Fills the hose finished (counted right away). */
+        quint64 escaped;    /**< Cones that left the hose range not full (counted right away). */
+        Stats () : spawned(0), filled(0), missed(0), blocked(0), completed(0), escaped(0) { }
+        /** @return Fraction of cones that left the belt full. */
+        double fillRatio () const { return filled + missed ? (double)filled / (filled + missed) : 0.0; }
+    };
+
+    /** @return Running totals. */
+    const Stats & stats () const { return stats_; }
+
+    bool saturated () const;
+
+    /** @return Distribution of cone spawn-to-full times (seconds). */
+    const QuantileSketch & fillLatency () const { return fillLatency_; }
+
+    /** @return Distribution of hose idle gaps between fills (seconds). */
+    const QuantileSketch & idleGaps () const { return idleGaps_; }
+
+    /** If on, updateHose() follows command() instead of planning. */
+    void setExternalControl (bool on) { external_ = on; }
+
+    /** @return True if under external control. */
+    bool externalControl () const { return external_; }
+
+    /** Set the command followed under external control. */
+    void command (const HoseCommand &c) { command_ = c; }
+
 public slots:
 
     void update ();
@@ -134,10 +239,9 @@ public slots:
 
     void setConeRate (double v) {
         p_.coneRate = v;
-        // eliminate lag when rate increasing
-        double next = 1.0 / p_.coneRate;
-        if (newconet_ - t_ > next)
-            newconet_ = t_ + next;
+        // an arrival that's already due is spawned on the next update()
+        if (!exhausted_ && next_.t > t_)
+            arrivals_->rateChanged(v, t_, rng_, next_);
     }
 
     /** This "variance" is the width (via -X edge) of the drop area. */
@@ -152,6 +256,7 @@ public slots:
 
     void setHoseSpeed (double v) {
         p_.hoseSpeed = v;
+        drive_->setSpeed(v);
     }
 
     void setFillRate (double v) {
@@ -166,12 +271,48 @@ private:
 
     Parameters p_;          /**< Current parameters. */
     double t_;              /**< Current timestamp. */
-    double newconet_;       /**< Timestamp of next cone creation. */
-    QList<Cone *> cones_;   /**< All the cones. */
+    ArrivalModel *arrivals_;/**< Cone arrival process (owned). */
+    ArrivalModel::Arrival next_; /**< Next cone creation. */
+    bool exhausted_;        /**< Arrival model has no more arrivals. */
+    QList<Cone *> cones_;   /**< All the cones, in spawn order. */
+    QList<Cone *> byX_;     /**< Same cones, sorted by X. The belt moves them
+                                 all equally so only spawning changes the
+                                 order. */
     Hose hose_;             /**< The hose head. */
+    HoseDrive *drive_;      /**< Moves hose_ (owned). */
+    qint64 planBudget_;     /**< Target selection time limit (ns), 0 = none. */
+    bool degraded_;         /**< Last target selection was cut short. */
+    int parallelThreshold_; /**< Cone count to go parallel at, 0 = never. */
+    quint32 nextid_;        /**< Next Cone::id. */
+    bool external_;         /**< Under external control? */
+    HoseCommand command_;   /**< Current external command. */
+    Rng rng_;               /**< Random numbers (spawn positions, arrivals). */
+    Stats stats_;           /**< Running totals. */
+    QuantileSketch fillLatency_; /**< Spawn-to-full times. */
+    QuantileSketch idleGaps_;    /**< Time from end of one fill to start of the next. */
+    double idleSince_;      /**< When the last fill ended. */
+    double beltTravel_;     /**< How far the belt has moved in total. */
+    QMultiHash<qint64, Cone *> spawnGrid_; /**< Cones by Cone::cell. */
+    double lastBlocked_;    /**< When an arrival was last dropped. */
+
+    /** One slice of the target selection scan in updateHose(). */
+    struct PlanChunk {
+        const Simulator *sim;       /**< Simulator being planned. */
+        int begin;                  /**< First index in cones_. */
+        int end;                    /**< One past the last index in cones_. */
+        const QElapsedTimer *timer; /**< Budget clock, NULL if unlimited. */
+        Cone *best;                 /**< Quickest fillable cone, or NULL. */
+        QList<Cone *> urgent;       /**< Urgent cones, in cones_ order. */
+        bool cut;                   /**< Ran out of budget. */
+    };
 
+    bool parallel () const;
     void updateCones ();
+    bool spawnRoom (const QPointF &pos) const;
+    void addCone (Cone *cone);
     void updateHose (Hose &h);
+    void followCommand (Hose &h);
+    static void scanChunk (PlanChunk &c);
 
 };
 
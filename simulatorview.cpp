@@ -28,7 +28,11 @@
 
 #include "simulatorview.h"
 #include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
 #include <QtGlobal>
+#include <cmath>
+#include "tracelog.h"
 
 #define BACKGROUND_COLOR    Qt::blue
 #define BELT_COLOR          Qt::lightGray
@@ -45,8 +49,11 @@
 #define CONE_FULL_COLOR     Qt::green
 #define CONE_BORDER_COLOR   Qt::black
 #define CONE_TARGETED_COLOR Qt::white
-#define CONE_WIDTH          1.5
-#define CONE_HEIGHT         2.0
+#define DENSITY_COLOR       Qt::red
+#define DENSITY_MIN_PIXELS  3.0     /**< Draw density instead of cones narrower than this. */
+#define DENSITY_BIN_PIXELS  4       /**< Density bin width. */
+#define ZOOM_STEP           1.25    /**< Zoom factor per wheel notch. */
+#define ZOOM_MIN_WIDTH      4.0     /**< Narrowest view (belt units). */
 
 
 //-----------------------------------------------------------------------------
@@ -74,11 +81,180 @@ SimulatorView::SimulatorView (QWidget *parent) :
     QFrame(parent),
     sim_(NULL),
     viewXmin_(-12.0),
-    viewXmax_(36.0)
+    viewXmax_(36.0),
+    zoomed_(false),
+    dragX_(0)
 {
 }
 
 
+//-----------------------------------------------------------------------------
+/**
+ * The view bounds used when AUTO_BOUNDS is on: from the back of the drop
+ * area to as far past the hose range as the drop area is before it.
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::autoBounds (const Simulator::Parameters &sp, double &xmin, double &xmax) {
+
+    xmin = sp.coneDrop.left();
+    xmax = sp.hoseRange.right() + (sp.hoseRange.left() - sp.coneDrop.right());
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  Pixels per belt unit when showing [xmin, xmax] in rect.
+ */
+//-----------------------------------------------------------------------------
+
+double SimulatorView::viewScale (const QRect &rect, double xmin, double xmax, double beltWidth) {
+
+    return qMin(rect.width() / (xmax - xmin), rect.height() / beltWidth);
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * The belt range actually on screen, which is wider than [xmin, xmax] if the
+ * belt width is what limits the scale.
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::visibleRange (const QRect &rect, double xmin, double xmax,
+                                  double beltWidth, double &vmin, double &vmax)
+{
+
+    double half = rect.width() / viewScale(rect, xmin, xmax, beltWidth) / 2.0;
+    vmin = (xmin + xmax) / 2.0 - half;
+    vmax = (xmin + xmax) / 2.0 + half;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Draw the current simulation. All the actual drawing is in render(); this
+ * just works out what's visible and fetches only those cones (or their
+ * density, if they'd be too small to see).
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::paintEvent (QPaintEvent *) {
+
+    TRACE_SPAN("SimulatorView::paintEvent");
+
+    if (!sim_)
+        return;
+
+    const Simulator::Parameters &sp = sim_->params();
+
+#if AUTO_BOUNDS
+    if (!zoomed_)
+        autoBounds(sp, viewXmin_, viewXmax_);
+#endif
+
+    double vmin, vmax;
+    visibleRange(rect(), viewXmin_, viewXmax_, sp.beltWidth, vmin, vmax);
+
+    QPainter p(this);
+    if (CONE_WIDTH * viewScale(rect(), viewXmin_, viewXmax_, sp.beltWidth) < DENSITY_MIN_PIXELS) {
+        QVector<int> density = sim_->coneDensity(vmin, vmax, qMax(1, rect().width() / DENSITY_BIN_PIXELS));
+        render(p, rect(), sp, sim_->hose(), QList<Simulator::Cone *>(), viewXmin_, viewXmax_, &density);
+    } else {
+        QList<Simulator::Cone *> cones = sim_->conesInRange(vmin - CONE_WIDTH / 2.0, vmax + CONE_WIDTH / 2.0);
+        render(p, rect(), sp, sim_->hose(), cones, viewXmin_, viewXmax_);
+    }
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  Belt X coordinate at widget X coordinate x.
+ */
+//-----------------------------------------------------------------------------
+
+double SimulatorView::beltX (int x) const {
+
+    double scale = viewScale(rect(), viewXmin_, viewXmax_, sim_->params().beltWidth);
+    return (viewXmin_ + viewXmax_) / 2.0 - (x - rect().center().x()) / scale;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Zoom in / out, keeping the belt position under the cursor fixed.
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::wheelEvent (QWheelEvent *e) {
+
+    if (!sim_)
+        return;
+
+    double factor = pow(ZOOM_STEP, -e->delta() / 120.0);
+    double anchor = beltX(e->x());
+    double xmin = anchor + (viewXmin_ - anchor) * factor;
+    double xmax = anchor + (viewXmax_ - anchor) * factor;
+
+    if (xmax - xmin >= ZOOM_MIN_WIDTH) {
+        viewXmin_ = xmin;
+        viewXmax_ = xmax;
+        zoomed_ = true;
+        update();
+    }
+
+    e->accept();
+
+}
+
+
+void SimulatorView::mousePressEvent (QMouseEvent *e) {
+
+    dragX_ = e->x();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Pan so the belt position under the cursor follows it.
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::mouseMoveEvent (QMouseEvent *e) {
+
+    if (!sim_ || !(e->buttons() & Qt::LeftButton))
+        return;
+
+    double shift = beltX(dragX_) - beltX(e->x());
+    viewXmin_ += shift;
+    viewXmax_ += shift;
+    dragX_ = e->x();
+    zoomed_ = true;
+    update();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Back to the default bounds.
+ */
+//-----------------------------------------------------------------------------
+
+void SimulatorView::mouseDoubleClickEvent (QMouseEvent *) {
+
+    zoomed_ = false;
+    update();
+
+}
+
+
 //-----------------------------------------------------------------------------
 /**
  * Draw everything. A QTransform is used to put everything in belt coordinates.
@@ -98,34 +274,40 @@ SimulatorView::SimulatorView (QWidget *parent) :
  * spawn area being somewhere in X<0. So you should probably use that same
  * system when picking initial simulation parameters to keep the view looking
  * OK.
+ *
+ * This is static and only touches what it's given, so it can also draw a
+ * Simulator::Snapshot into a QImage on another thread (see FrameExporter).
+ *
+ * @param   p       Painter to draw with.
+ * @param   rect    Area to fill.
+ * @param   sp      Simulation parameters.
+ * @param   hose    Hose head.
+ * @param   cones   Cones to draw.
+ * @param   xmin    Minimum visible belt position.
+ * @param   xmax    Maximum visible belt position.
+ * @param   density If not NULL, cone counts over visibleRange() to draw as a
+ *                  density overview (in addition to any cones).
  */
 //-----------------------------------------------------------------------------
 
-void SimulatorView::paintEvent (QPaintEvent *) {
-
-    if (!sim_)
-        return;
-
-    const QList<Simulator::Cone *> &cones = sim_->cones();
-    const Simulator::Parameters &sp = sim_->params();
-    const Simulator::Hose &hose = sim_->hose();
-
-#if AUTO_BOUNDS
-    viewXmin_ = sp.coneDrop.left();
-    viewXmax_ = sp.hoseRange.right() + (sp.hoseRange.left() - sp.coneDrop.right());
-#endif
+void SimulatorView::render (QPainter &p, const QRect &rect,
+                            const Simulator::Parameters &sp,
+                            const Simulator::Hose &hose,
+                            const QList<Simulator::Cone *> &cones,
+                            double xmin, double xmax,
+                            const QVector<int> *density)
+{
 
-    QPainter p(this);
     p.setRenderHint(QPainter::Antialiasing);
 
     // background
-    p.fillRect(rect(), BACKGROUND_COLOR);
+    p.fillRect(rect, BACKGROUND_COLOR);
 
     // set transform so we can draw in belt coords from here on down
-    QRectF view(viewXmin_, 0.0, viewXmax_ - viewXmin_, sp.beltWidth);
-    double scale = qMin(rect().width() / view.width(), rect().height() / view.height());
+    QRectF view(xmin, 0.0, xmax - xmin, sp.beltWidth);
+    double scale = viewScale(rect, xmin, xmax, sp.beltWidth);
     QTransform t = QTransform()
-            .translate(rect().center().x(), rect().center().y())
+            .translate(rect.center().x(), rect.center().y())
             .scale(-1, 1)
             .scale(scale, scale)
             .translate(-view.center().x(), -view.center().y())
@@ -141,6 +323,21 @@ void SimulatorView::paintEvent (QPaintEvent *) {
     // hose range
     p.fillRect(sp.hoseRange, HOSE_AREA_COLOR);
 
+    // density overview
+    if (density && !density->isEmpty()) {
+        double vmin, vmax;
+        visibleRange(rect, xmin, xmax, sp.beltWidth, vmin, vmax);
+        double width = (vmax - vmin) / density->size();
+        int peak = 1;
+        foreach (int count, *density)
+            peak = qMax(peak, count);
+        for (int n = 0; n < density->size(); ++ n) {
+            QColor color(DENSITY_COLOR);
+            color.setAlphaF((double)(*density)[n] / peak);
+            p.fillRect(QRectF(vmin + n * width, 0.0, width, sp.beltWidth), color);
+        }
+    }
+
     // cones
     p.setBrush(Qt::NoBrush);
     foreach (const Simulator::Cone *cone, cones) {
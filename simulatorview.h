@@ -32,12 +32,19 @@
 #include <QFrame>
 #include "simulator.h"
 
+class QPainter;
+
 #define AUTO_BOUNDS 1 /**< If 1, viewport bounds are set automatically. */
 
 
 //-----------------------------------------------------------------------------
 /**
  * A widget that draws the current simulation. See paintEvent().
+ *
+ * The mouse wheel zooms around the cursor, dragging pans, and double clicking
+ * goes back to the default bounds. Only cones in the visible range are
+ * fetched from the simulator, and when zoomed out far enough that cones
+ * would be tiny a density overview is drawn instead.
  */
 //-----------------------------------------------------------------------------
 
@@ -53,6 +60,20 @@ public:
         update();
     }
 
+    static void autoBounds (const Simulator::Parameters &sp, double &xmin, double &xmax);
+
+    static double viewScale (const QRect &rect, double xmin, double xmax, double beltWidth);
+
+    static void visibleRange (const QRect &rect, double xmin, double xmax,
+                              double beltWidth, double &vmin, double &vmax);
+
+    static void render (QPainter &p, const QRect &rect,
+                        const Simulator::Parameters &sp,
+                        const Simulator::Hose &hose,
+                        const QList<Simulator::Cone *> &cones,
+                        double xmin, double xmax,
+                        const QVector<int> *density = NULL);
+
 #if !AUTO_BOUNDS
     void setViewBounds (double xmin, double xmax) {
         viewXmin_ = xmin;
@@ -64,13 +85,21 @@ public:
 protected:
 
     void paintEvent (QPaintEvent *);
+    void wheelEvent (QWheelEvent *);
+    void mousePressEvent (QMouseEvent *);
+    void mouseMoveEvent (QMouseEvent *);
+    void mouseDoubleClickEvent (QMouseEvent *);
 
 private:
 
     const Simulator *sim_;  /**< Simulator being drawn. */
     double viewXmin_;       /**< Minimum visible belt position. */
     double viewXmax_;       /**< Maximum visible belt position. */
-    
+    bool zoomed_;           /**< User has zoomed / panned (overrides AUTO_BOUNDS). */
+    int dragX_;             /**< Last mouse X while dragging. */
+
+    double beltX (int x) const;
+
 };
 
 
@@ -0,0 +1,113 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#include "standincontroller.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Constructor. Call open() next.
+ */
+//-----------------------------------------------------------------------------
+
+StandInController::StandInController (const QString &name, PlantLink::CommandPath path) :
+    client_(name, path),
+    hasTarget_(false),
+    target_(0)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Answer every step until the plant closes or stops publishing.
+ *
+ * @return  Number of steps answered.
+ */
+//-----------------------------------------------------------------------------
+
+quint64 StandInController::run (int timeoutMsecs) {
+
+    quint64 last = PlantLink::NoStep, answered = 0;
+    PlantLink::Command c;
+
+    while (client_.waitForState(last, timeoutMsecs)) {
+
+        // decide straight from shared memory; redo it if the plant
+        // overwrote the slot while we were looking
+        int seq;
+        const PlantLink::State *s;
+        do {
+            s = client_.beginRead(seq);
+            c.step = s->step;
+            decide(s, client_.coneCount(s), c);
+        } while (!client_.endRead(s, seq));
+
+        hasTarget_ = (c.hasTarget != 0);
+        target_ = c.targetId;
+        if (!client_.send(c))
+            break;
+
+        last = c.step;
+        ++ answered;
+
+    }
+
+    return answered;
+
+}
+
+
+void StandInController::decide (const PlantLink::State *s, int count, PlantLink::Command &c) const {
+
+    const PlantLink::Cone *cones = s->cones();
+    int best = -1;
+
+    for (int n = 0; n < count; ++ n) {
+        const PlantLink::Cone &cone = cones[n];
+        if (cone.fill >= 1.0 || !s->hoseRange.contains(cone.x, cone.y))
+            continue;
+        double timelimit = (s->hoseRange.right() - cone.x) / s->beltSpeed;
+        double filltime = (1.0 - cone.fill) / s->hoseFillRate;
+        if (filltime > timelimit)
+            continue;
+        if (hasTarget_ && cone.id == target_) {
+            best = n;
+            break;
+        }
+        if (best < 0 || cone.x > cones[best].x)
+            best = n;
+    }
+
+    c.hasTarget = (best >= 0);
+    c.targetId = (best >= 0 ? cones[best].id : 0);
+    c.destX = s->hoseRange.left();
+    c.destY = s->hoseRange.center().y();
+
+}
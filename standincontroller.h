@@ -0,0 +1,67 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+#ifndef STANDINCONTROLLER_H
+#define STANDINCONTROLLER_H
+
+#include "plantlink.h"
+
+
+//-----------------------------------------------------------------------------
+/**
+ * A deliberately simple external controller for trying out the plant link
+ * without the real controller software. Each step it sticks with its current
+ * target while that can still be filled, otherwise picks the unfilled cone in
+ * the hose range that is closest to leaving but can still be filled in time.
+ * With nothing to do it parks at the inlet.
+ */
+//-----------------------------------------------------------------------------
+
+class StandInController {
+public:
+
+    StandInController (const QString &name, PlantLink::CommandPath path);
+
+    bool open (int msecs) { return client_.open(msecs); }
+    QString errorString () const { return client_.errorString(); }
+
+    quint64 run (int timeoutMsecs);
+
+private:
+
+    PlantClient client_;    /**< Link to the plant. */
+    bool hasTarget_;        /**< Currently targeting a cone? */
+    quint32 target_;        /**< Current target cone id. */
+
+    void decide (const PlantLink::State *s, int count, PlantLink::Command &c) const;
+
+};
+
+
+#endif // STANDINCONTROLLER_H
@@ -0,0 +1,386 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#include "tracelog.h"
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QQueue>
+
+#define BUFFER_EVENTS   4096    /**< Events per thread buffer before handing it to the writer. */
+
+namespace TraceLog {
+
+
+/** One recorded span. */
+struct Event {
+    const char *name;   /**< Name. */
+    qint64 start;       /**< Start time (ns since start()). */
+    qint64 end;         /**< End time (ns since start()). */
+};
+
+
+/** Events from one thread, on their way to the file. */
+struct Batch {
+    int tid;                /**< Thread id in the trace. */
+    QString threadName;     /**< If not empty, a thread name record. */
+    QVector<Event> events;  /**< Events to write. */
+};
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Formats and writes batches as they are posted.
+ */
+//-----------------------------------------------------------------------------
+
+class Writer : public QThread {
+public:
+    explicit Writer (QFile *file) : file_(file), finished_(false) { }
+    ~Writer () { delete file_; }
+    void post (const Batch &batch);
+    void finish ();
+protected:
+    void run ();
+private:
+    QFile *file_;           /**< Output (owned, open). */
+    QMutex mutex_;          /**< Protects queue_ and finished_. */
+    QWaitCondition ready_;  /**< Signalled on post() and finish(). */
+    QQueue<Batch> queue_;   /**< Batches not written yet. */
+    bool finished_;         /**< Stop once queue_ is empty. */
+};
+
+
+/** One thread's events. */
+struct Buffer {
+    int tid;                /**< Thread id in the trace. */
+    QString name;           /**< Thread name. */
+    QMutex mutex;           /**< Protects events (only contended by stop()). */
+    QVector<Event> events;  /**< Events not handed to the writer yet. */
+    ~Buffer ();
+};
+
+
+static QMutex traceLock;                    /**< Protects writer and buffers. */
+static Writer *writer = NULL;               /**< Current writer, NULL if stopped. */
+static QList<Buffer *> buffers;             /**< Every thread's buffer. */
+static QThreadStorage<Buffer *> local;      /**< This thread's buffer. */
+static QAtomicInt on;                       /**< Nonzero while tracing. */
+static QAtomicInt nextTid(1);               /**< Next Buffer::tid. */
+static QElapsedTimer traceClock;            /**< Trace timestamps. */
+
+
+void Writer::post (const Batch &batch) {
+
+    QMutexLocker locker(&mutex_);
+    queue_.enqueue(batch);
+    ready_.wakeOne();
+
+}
+
+
+void Writer::finish () {
+
+    mutex_.lock();
+    finished_ = true;
+    ready_.wakeOne();
+    mutex_.unlock();
+    wait();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  str with the characters JSON doesn't allow in a string escaped.
+ *          Thread names come from QObject::objectName(), so they can hold
+ *          anything.
+ */
+//-----------------------------------------------------------------------------
+
+static QString jsonEscape (const QString &str) {
+
+    QString escaped;
+    escaped.reserve(str.size());
+
+    foreach (QChar c, str) {
+        if (c == '"' || c == '\\') {
+            escaped += QChar('\\');
+            escaped += c;
+        } else if (c.unicode() < 0x20) {
+            escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        } else {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+
+}
+
+
+void Writer::run () {
+
+    QTextStream out(file_);
+    bool first = true;
+
+    out << "[";
+
+    forever {
+
+        mutex_.lock();
+        while (queue_.isEmpty() && !finished_)
+            ready_.wait(&mutex_);
+        if (queue_.isEmpty()) {
+            mutex_.unlock();
+            break;
+        }
+        Batch batch = queue_.dequeue();
+        mutex_.unlock();
+
+        if (!batch.threadName.isEmpty()) {
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << batch.tid
+                << ",\"args\":{\"name\":\"" << jsonEscape(batch.threadName) << "\"}}";
+            first = false;
+        }
+
+        foreach (const Event &e, batch.events) {
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"" << jsonEscape(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << batch.tid
+                << ",\"ts\":" << QString::number(e.start / 1000.0, 'f', 3)
+                << ",\"dur\":" << QString::number((e.end - e.start) / 1000.0, 'f', 3) << "}";
+            first = false;
+        }
+
+    }
+
+    out << "\n]\n";
+    out.flush();
+    file_->close();
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Threads that exit while tracing still get their last events written.
+ */
+//-----------------------------------------------------------------------------
+
+Buffer::~Buffer () {
+
+    QMutexLocker locker(&traceLock);
+
+    buffers.removeOne(this);
+    if (writer && !events.isEmpty()) {
+        Batch batch;
+        batch.tid = tid;
+        batch.events = events;
+        writer->post(batch);
+    }
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * @return  This thread's buffer, created (and announced to the writer) on
+ *          first use.
+ */
+//-----------------------------------------------------------------------------
+
+static Buffer * threadBuffer () {
+
+    if (local.hasLocalData())
+        return local.localData();
+
+    Buffer *b = new Buffer;
+    b->tid = nextTid.fetchAndAddOrdered(1);
+    b->name = QThread::currentThread()->objectName();
+    if (b->name.isEmpty()) {
+        if (QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread())
+            b->name = "main";
+        else
+            b->name = QString("thread %1").arg(b->tid);
+    }
+    b->events.reserve(BUFFER_EVENTS);
+    local.setLocalData(b);
+
+    QMutexLocker locker(&traceLock);
+    buffers.append(b);
+    if (writer) {
+        Batch batch;
+        batch.tid = b->tid;
+        batch.threadName = b->name;
+        writer->post(batch);
+    }
+
+    return b;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Add an event to this thread's buffer, handing the buffer to the writer when
+ * it's full. The buffer lock is released before the global lock is taken.
+ */
+//-----------------------------------------------------------------------------
+
+static void record (const char *name, qint64 start, qint64 end) {
+
+    Buffer *b = threadBuffer();
+    Batch batch;
+
+    b->mutex.lock();
+    Event e = { name, start, end };
+    b->events.append(e);
+    if (b->events.size() >= BUFFER_EVENTS) {
+        batch.tid = b->tid;
+        batch.events.swap(b->events);
+        b->events.reserve(BUFFER_EVENTS);
+    }
+    b->mutex.unlock();
+
+    if (!batch.events.isEmpty()) {
+        QMutexLocker locker(&traceLock);
+        if (writer)
+            writer->post(batch);
+    }
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Start tracing to a file. Timestamps are relative to this call.
+ *
+ * @return  False if the file couldn't be opened or tracing is already on.
+ */
+//-----------------------------------------------------------------------------
+
+bool start (const QString &filename) {
+
+    QMutexLocker locker(&traceLock);
+
+    if (writer)
+        return false;
+
+    QFile *file = new QFile(filename);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        delete file;
+        return false;
+    }
+
+    writer = new Writer(file);
+    writer->start(QThread::LowPriority);
+
+    foreach (Buffer *b, buffers) {
+        QMutexLocker bufferLocker(&b->mutex);
+        b->events.clear();
+        Batch batch;
+        batch.tid = b->tid;
+        batch.threadName = b->name;
+        writer->post(batch);
+    }
+
+    traceClock.start();
+    on.fetchAndStoreOrdered(1);
+    return true;
+
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Stop tracing, write out everything recorded and close the file. Spans that
+ * are still open when this is called are not written.
+ */
+//-----------------------------------------------------------------------------
+
+void stop () {
+
+    QMutexLocker locker(&traceLock);
+
+    if (!writer)
+        return;
+
+    on.fetchAndStoreOrdered(0);
+
+    foreach (Buffer *b, buffers) {
+        Batch batch;
+        batch.tid = b->tid;
+        b->mutex.lock();
+        batch.events.swap(b->events);
+        b->mutex.unlock();
+        if (!batch.events.isEmpty())
+            writer->post(batch);
+    }
+
+    writer->finish();
+    delete writer;
+    writer = NULL;
+
+}
+
+
+/** @return True while tracing. */
+bool active () {
+
+    return on;
+
+}
+
+
+Span::Span (const char *name) :
+    name_(on ? name : NULL),
+    start_(name_ ? traceClock.nsecsElapsed() : 0)
+{
+}
+
+
+Span::~Span () {
+
+    if (name_)
+        record(name_, start_, traceClock.nsecsElapsed());
+
+}
+
+
+}
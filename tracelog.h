@@ -0,0 +1,75 @@
+//=============================================================================
+/*
+ * https://github.com/JC3/Cones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016, Jason Cipriani
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+//=============================================================================
+
+
+
+#ifndef TRACELOG_H
+#define TRACELOG_H
+
+#include <QString>
+#include <QtGlobal>
+
+
+//-----------------------------------------------------------------------------
+/**
+ * Span profiling in Chrome trace-event format, so a run can be opened in
+ * chrome://tracing or ui.perfetto.dev. Put TRACE_SPAN("Class::function") at
+ * the top of a scope to record how long it takes.
+ *
+ * Each thread records into its own buffer. A full buffer is handed to a
+ * writer thread, which does the formatting and file I/O. When tracing is off
+ * a span costs one flag check.
+ */
+//-----------------------------------------------------------------------------
+
+namespace TraceLog {
+
+bool start (const QString &filename);
+void stop ();
+bool active ();
+
+
+/** Records the time between construction and destruction as one event.
+ *  name must outlive the trace (use a string literal). */
+class Span {
+public:
+    explicit Span (const char *name);
+    ~Span ();
+private:
+    const char *name_;  /**< Event name, NULL if not tracing. */
+    qint64 start_;      /**< Start time (ns). */
+    Q_DISABLE_COPY(Span)
+};
+
+}
+
+/** Trace the rest of the enclosing scope as name. */
+#define TRACE_SPAN(name) TraceLog::Span traceSpan_(name)
+
+
+#endif // TRACELOG_H